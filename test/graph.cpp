@@ -1,308 +1,7851 @@
 #include <iostream>
 #include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <list>
+#include <math.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 using namespace std;
 
-class gnode
+// Traversal counters and phase timings, compiled in with -DGRAPH_STATS and
+// to nothing otherwise. Each thread counts into its own block, so the hot
+// loops never share a cache line; stats::merged() sums the blocks and
+// stats::trace() writes every timed phase as Chrome trace-event JSON
+// (load it in chrome://tracing or Perfetto).
+#ifdef GRAPH_STATS
+struct trace_event
 {
-    string name;
-    int id;
-    gnode *next;
-    friend class graph;
+    const char *name;
+    long start;
+    long length;
+    long level;
+    long frontier;
 };
 
-class graph
+struct stat_block
 {
-private:
-    gnode *head[20];
-    int n;
-    int visit[20];
+    int tid;
+    long visited;
+    long scanned;
+    long levels;
+    long switches;
+    vector<trace_event> events;
+};
+
+class stats
+{
+    // Blocks outlive their threads so counts from finished workers still
+    // show up; there is one per thread that ever traversed.
+    static mutex &lock()
+    {
+        static mutex m;
+        return m;
+    }
+    static vector<stat_block *> &blocks()
+    {
+        static vector<stat_block *> all;
+        return all;
+    }
+    static stat_block *enrol()
+    {
+        lock_guard<mutex> hold(lock());
+        stat_block *b = new stat_block();
+        b->tid = (int)blocks().size() + 1;
+        blocks().push_back(b);
+        return b;
+    }
 
 public:
-    graph()
+    static stat_block &local()
     {
-        cout << "Number of people? ";
-        cin >> n;
-        for (int i = 0; i < n; i++)
+        thread_local stat_block *b = enrol();
+        return *b;
+    }
+    static long now()
+    {
+        static const chrono::steady_clock::time_point origin = chrono::steady_clock::now();
+        return (long)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - origin).count();
+    }
+    static stat_block merged()
+    {
+        lock_guard<mutex> hold(lock());
+        stat_block sum = stat_block();
+        for (size_t i = 0; i < blocks().size(); i++)
         {
-            head[i] = new gnode;
-            cout << "Enter name of person " << i << "\n";
-            cin >> head[i]->name;
-            head[i]->id = i;
-            head[i]->next = NULL;
+            sum.visited += blocks()[i]->visited;
+            sum.scanned += blocks()[i]->scanned;
+            sum.levels += blocks()[i]->levels;
+            sum.switches += blocks()[i]->switches;
         }
+        return sum;
+    }
+    static void trace(ostream &out)
+    {
+        lock_guard<mutex> hold(lock());
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        for (size_t i = 0; i < blocks().size(); i++)
+        {
+            const vector<trace_event> &ev = blocks()[i]->events;
+            for (size_t j = 0; j < ev.size(); j++)
+            {
+                out << (first ? "\n" : ",\n") << "{\"name\":\"" << ev[j].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << blocks()[i]->tid
+                    << ",\"ts\":" << ev[j].start << ",\"dur\":" << ev[j].length;
+                if (ev[j].level >= 0)
+                {
+                    out << ",\"args\":{\"level\":" << ev[j].level << ",\"frontier\":" << ev[j].frontier << "}";
+                }
+                out << "}";
+                first = false;
+            }
+        }
+        out << "\n]}\n";
     }
-
-    void create();
-    void display();
-    void dfs_r();
-    void dfs_r(string v);
-    void dfs_nr();
-    void bfs();
-    int isthere(string fren);
-    int where(string fren);
 };
 
-class stack
+// Times the enclosing scope as one trace event.
+class stat_phase
 {
-    int top;
-    string data[30];
+    trace_event ev;
 
 public:
-    stack()
+    stat_phase(const char *name)
     {
-        top = -1;
+        ev.name = name;
+        ev.start = stats::now();
+        ev.level = -1;
+        ev.frontier = 0;
     }
-
-    void push(string temp)
+    ~stat_phase()
     {
-        top++;
-        data[top] = temp;
+        ev.length = stats::now() - ev.start;
+        stats::local().events.push_back(ev);
+    }
+    void args(long level, long frontier)
+    {
+        ev.level = level;
+        ev.frontier = frontier;
     }
+};
 
-    string pop()
+#define STAT_ADD(field, k) (stats::local().field += (k))
+#define STAT_PHASE(var, name) stat_phase var(name)
+#define STAT_ARGS(var, level, frontier) var.args(level, frontier)
+#else
+#define STAT_ADD(field, k) ((void)0)
+#define STAT_PHASE(var, name)
+#define STAT_ARGS(var, level, frontier) ((void)0)
+#endif
+
+// Runs body(t) for every t in [0, threads): body(0) on the calling thread,
+// the rest on threads of their own, and returns once all of them have.
+template <class F>
+void run_on_threads(int threads, F body)
+{
+    vector<thread> pool;
+    for (int t = 1; t < threads; t++)
     {
-        string temp = data[top];
-        top--;
-        return temp;
+        pool.push_back(thread(body, t));
     }
-    int empty;
+    body(0);
+    for (size_t t = 0; t < pool.size(); t++)
+    {
+        pool[t].join();
+    }
+}
+
+class gnode
+{
+    string name;
+    int id;
+    bool dead;
+    float weight;
+    long formed;
+    gnode *next;
     friend class graph;
 };
 
-class queue
+// Changes since the last published version. Ids at or past the base
+// snapshot's size refer to entries of `people`, in order. Removals are
+// applied after additions. `strength` and `formed` (when each friendship
+// was made, in seconds since the epoch) run beside `friendships`, and are
+// empty when none were given.
+struct delta
 {
-    int front;
-    int rear;
-    string q[10];
+    vector<string> people;
+    vector<pair<int, int>> friendships;
+    vector<float> strength;
+    vector<long> formed;
+    vector<pair<int, int>> unfriended;
+    vector<int> departed;
 
-public:
-    queue()
+    bool empty() const
     {
-        front = -1;
-        rear = -1;
+        return people.empty() && friendships.empty() && unfriended.empty() && departed.empty();
     }
-    void enqueue(string temp)
+};
+
+// Bytes held by one structure, split by what they hold. Heap blocks are
+// charged at glibc malloc's size (8 byte header, 16 byte rounding, 32 byte
+// minimum); the rounding and unused vector capacity go to `slack`. `names`
+// counts string heap buffers as they are, with short names kept inline
+// (SSO); `names_without_sso` is what they'd cost if every name were on the
+// heap.
+struct memory_report
+{
+    size_t headers;
+    size_t adjacency;
+    size_t names;
+    size_t names_without_sso;
+    size_t visited;
+    size_t slack;
+
+    memory_report() : headers(0), adjacency(0), names(0), names_without_sso(0), visited(0), slack(0) {}
+
+    size_t total() const
     {
-        rear++;
-        q[rear] = temp;
+        return headers + adjacency + names + visited + slack;
     }
-    string dequeue()
+    static size_t block(size_t bytes)
     {
-        front++;
-        string temp = q[front];
-        return temp;
+        return max((size_t)32, (bytes + 8 + 15) & ~(size_t)15);
     }
-    friend class graph;
+    // Charges one heap block of `used` bytes to `part`.
+    void heap(size_t &part, size_t used)
+    {
+        part += used;
+        slack += block(used) - used;
+    }
+    template <class T>
+    void array(size_t &part, const vector<T> &v)
+    {
+        if (v.capacity() > 0)
+        {
+            heap(part, v.size() * sizeof(T));
+            slack += (v.capacity() - v.size()) * sizeof(T);
+        }
+    }
+    void name(const string &s)
+    {
+        if (s.capacity() > string().capacity())
+        {
+            heap(names, s.size() + 1);
+            slack += s.capacity() - s.size();
+        }
+        names_without_sso += block(s.size() + 1);
+    }
+    void print(const char *title) const;
 };
 
-int graph::isthere(string fren)
+// One weighted friendship, ordered by its ends.
+struct arc
 {
-    for (int i = 0; i < n; i++)
+    int from;
+    int to;
+    float weight;
+    long formed;
+
+    arc(int a, int b, float w, long t = 0) : from(a), to(b), weight(w), formed(t) {}
+    bool operator<(const arc &o) const
+    {
+        return from != o.from ? from < o.from : to < o.to;
+    }
+};
+
+// LEB128 varints with zigzag for signed values, as used by packed
+// neighbour lists.
+void put_varint(vector<unsigned char> &out, unsigned long x)
+{
+    while (x >= 0x80)
+    {
+        out.push_back((unsigned char)(x | 0x80));
+        x >>= 7;
+    }
+    out.push_back((unsigned char)x);
+}
+unsigned long get_varint(const unsigned char *&p)
+{
+    unsigned long x = *p & 0x7f;
+    for (int shift = 7; *p++ & 0x80; shift += 7)
+    {
+        x |= (unsigned long)(*p & 0x7f) << shift;
+    }
+    return x;
+}
+unsigned long zigzag(long x)
+{
+    return x < 0 ? ((unsigned long)-(x + 1) << 1) | 1 : (unsigned long)x << 1;
+}
+long unzigzag(unsigned long x)
+{
+    return (x & 1) ? -(long)(x >> 1) - 1 : (long)(x >> 1);
+}
+
+// Immutable, id-based (CSR) version of the friend graph. Neighbour lists are
+// sorted and free of duplicates; once published a snapshot is never modified.
+// A symmetric snapshot holds every friendship in both directions and marks
+// where each list passes its own id, so algorithms that only need each
+// friendship once can walk the upper half. Strengths, when any were given,
+// sit in `weight` next to the neighbour ids in `adj`.
+//
+// A timed snapshot has `stamp`, when each friendship was formed, beside
+// `adj` too, and a second copy of every list in `by_time` ordered by that
+// time, with the times in `when`. Windowed traversals binary search
+// `when` for the slice they need and never look at the rest.
+//
+// A packed snapshot drops `adj` and keeps each list in `bytes` instead, from
+// byte `packed_at[v]`: the first friend as a zigzag varint of its distance
+// from v, then each following friend as the varint of (gap - 1). `offset`
+// still counts edges, so degrees and `weight` indices are unchanged.
+class snapshot
+{
+    long version;
+    bool mutual;
+    bool integral;
+    bool packed;
+    vector<string> names;
+    unordered_map<string, int> index;
+    vector<int> offset;
+    vector<int> upper;
+    vector<int> adj;
+    vector<float> weight;
+    vector<long> stamp;
+    vector<long> when;
+    vector<int> by_time;
+    vector<long> packed_at;
+    vector<unsigned char> bytes;
+    friend class snapshot_store;
+
+    void pack();
+    void finish();
+    // Calls f(friend, edge index) over v's list, decoding it if packed,
+    // until f returns true.
+    template <class F>
+    void walk(int v, int from, F f) const
     {
-        if (fren == head[i]->name)
+        if (!packed)
         {
-            return 1;
+            for (int e = from; e < offset[v + 1]; e++)
+            {
+                if (f(adj[e], e))
+                {
+                    return;
+                }
+            }
+            return;
+        }
+        if (offset[v] == offset[v + 1])
+        {
+            return;
+        }
+        const unsigned char *p = &bytes[packed_at[v]];
+        long u = v + unzigzag(get_varint(p));
+        for (int e = offset[v];; e++)
+        {
+            if (e >= from && f((int)u, e))
+            {
+                return;
+            }
+            if (e + 1 == offset[v + 1])
+            {
+                return;
+            }
+            u += (long)get_varint(p) + 1;
         }
     }
-    return 0;
-}
 
-int graph::where(string fren)
+public:
+    snapshot(bool symmetric = false, bool compressed = false) : version(0), mutual(symmetric), integral(true), packed(compressed), offset(1, 0) {}
+
+    static snapshot *apply(const snapshot &base, const delta &d);
+    static snapshot *build(const snapshot &base, const delta &d, int threads);
+    memory_report memory() const;
+
+    long ver() const
+    {
+        return version;
+    }
+    bool symmetric() const
+    {
+        return mutual;
+    }
+    bool weighted() const
+    {
+        return !weight.empty();
+    }
+    bool compressed() const
+    {
+        return packed;
+    }
+    bool timed() const
+    {
+        return !stamp.empty();
+    }
+    // True when every strength is a whole number.
+    bool whole() const
+    {
+        return integral;
+    }
+    int size() const
+    {
+        return (int)names.size();
+    }
+    long edges() const
+    {
+        return (long)offset.back();
+    }
+    int degree(int v) const
+    {
+        return offset[v + 1] - offset[v];
+    }
+    const string &name(int v) const
+    {
+        return names[v];
+    }
+    int id(const string &who) const
+    {
+        unordered_map<string, int>::const_iterator it = index.find(who);
+        return it == index.end() ? -1 : it->second;
+    }
+    // False once the person has been removed; their id stays reserved.
+    bool present(int v) const
+    {
+        return id(names[v]) == v;
+    }
+    template <class F>
+    void for_each_friend(int v, F f) const
+    {
+        walk(v, offset[v], [&](int u, int) {
+            f(u);
+            return false;
+        });
+    }
+    // f(friend, strength); strength is 1 in unweighted snapshots.
+    template <class F>
+    void for_each_edge(int v, F f) const
+    {
+        walk(v, offset[v], [&](int u, int e) {
+            f(u, weight.empty() ? 1.0f : weight[e]);
+            return false;
+        });
+    }
+    // Friends with a larger id; symmetric snapshots only.
+    template <class F>
+    void for_each_upper(int v, F f) const
+    {
+        walk(v, upper[v], [&](int u, int) {
+            f(u);
+            return false;
+        });
+    }
+    // f(friend, formed) for friendships formed within [from, to], earliest
+    // first. Untimed snapshots count every friendship as formed at 0.
+    template <class F>
+    void for_each_friend_between(int v, long from, long to, F f) const
+    {
+        if (stamp.empty())
+        {
+            if (from <= 0 && 0 <= to)
+            {
+                walk(v, offset[v], [&](int u, int) {
+                    f(u, 0L);
+                    return false;
+                });
+            }
+            return;
+        }
+        vector<long>::const_iterator first = lower_bound(when.begin() + offset[v], when.begin() + offset[v + 1], from);
+        vector<long>::const_iterator last = upper_bound(first, when.begin() + offset[v + 1], to);
+        for (int e = (int)(first - when.begin()); e < (int)(last - when.begin()); e++)
+        {
+            f(by_time[e], when[e]);
+        }
+    }
+    // First friend of v for which pred holds, or -1; stops looking there.
+    template <class P>
+    int find_friend(int v, P pred) const
+    {
+        int found = -1;
+        walk(v, offset[v], [&](int u, int) {
+            if (pred(u))
+            {
+                found = u;
+            }
+            return found >= 0;
+        });
+        return found;
+    }
+};
+
+// RCU-style publication of snapshots. Readers pin the current version by
+// claiming an epoch slot (no locks); the single writer swaps in a new version
+// and frees retired ones once every slot that could still see them is gone,
+// either as it publishes or as the last such reader lets go. Slots come in
+// blocks of 64, and a pin that finds them all taken adds a block instead
+// of waiting, so any number of readers can pin at once.
+class snapshot_store
 {
-    for (int i = 0; i < n; i++)
+    static const int SLOTS = 64;
+    struct slot_block
     {
-        if (fren == head[i]->name)
+        atomic<unsigned long> slot[SLOTS];
+        atomic<slot_block *> next;
+
+        slot_block() : next(NULL)
         {
-            return i;
+            for (int i = 0; i < SLOTS; i++)
+            {
+                slot[i].store(0);
+            }
+        }
+    };
+    atomic<const snapshot *> current;
+    atomic<unsigned long> epoch;
+    slot_block slots;
+    mutex writer;
+    vector<pair<unsigned long, const snapshot *>> retired;
+    atomic<size_t> waiting;
+
+    void reclaim();
+    void unpin(atomic<unsigned long> *at);
+
+public:
+    class reader
+    {
+        snapshot_store *store;
+        atomic<unsigned long> *at;
+        const snapshot *snap;
+        friend class snapshot_store;
+
+    public:
+        reader(snapshot_store *s, atomic<unsigned long> *i, const snapshot *p) : store(s), at(i), snap(p) {}
+        reader(reader &&o) : store(o.store), at(o.at), snap(o.snap)
+        {
+            o.store = NULL;
+        }
+        reader(const reader &) = delete;
+        reader &operator=(const reader &) = delete;
+        ~reader()
+        {
+            if (store != NULL)
+            {
+                store->unpin(at);
+            }
         }
+        const snapshot &operator*() const
+        {
+            return *snap;
+        }
+        const snapshot *operator->() const
+        {
+            return snap;
+        }
+    };
+
+    snapshot_store(bool symmetric = false, bool compressed = false);
+    ~snapshot_store();
+    reader pin();
+    long publish(const delta &d, int threads = 1);
+    // Versions replaced but not yet freed, because a reader may hold them.
+    size_t retained() const
+    {
+        return waiting.load();
     }
-}
+};
 
-void graph::create()
+// Compile-time policies for static_graph: which way friendships go, what a
+// strength is stored as (no_weight stores none), how wide a stored id is
+// and how neighbour lists are laid out (list_storage, csr_storage or
+// packed_storage). The id width is storage only: the graph interface and
+// the kernels number people with int, so uint64_t ids cost more memory
+// without raising the limit of INT_MAX people.
+struct directed
 {
-    string fren;
-    char ch;
-    for (int i = 0; i < n; i++)
+    static constexpr bool symmetric = false;
+};
+struct undirected
+{
+    static constexpr bool symmetric = true;
+};
+struct no_weight
+{
+};
+
+// One strength per edge, beside whichever list layout holds the ids. The
+// no_weight version is empty, so layouts that inherit it pay nothing.
+template <class W>
+struct weight_array
+{
+    vector<W> strengths;
+
+    // What w reads back as once stored.
+    static float stored(float w)
     {
-        gnode *temp = head[i];
-        do
+        return (float)(W)w;
+    }
+    void push(float w)
+    {
+        strengths.push_back((W)w);
+    }
+    float at(size_t e) const
+    {
+        return (float)strengths[e];
+    }
+    void account(memory_report &r) const
+    {
+        r.array(r.adjacency, strengths);
+    }
+};
+template <>
+struct weight_array<no_weight>
+{
+    static float stored(float)
+    {
+        return 1;
+    }
+    void push(float) {}
+    float at(size_t) const
+    {
+        return 1;
+    }
+    void account(memory_report &) const {}
+};
+
+// A list_storage node. Pool indices stand in for pointers, so the id width
+// sets the whole node's size.
+template <class Id, class W>
+struct list_node
+{
+    Id to;
+    Id next;
+    W weight;
+
+    float strength() const
+    {
+        return (float)weight;
+    }
+    void set(float w)
+    {
+        weight = (W)w;
+    }
+};
+template <class Id>
+struct list_node<Id, no_weight>
+{
+    Id to;
+    Id next;
+
+    float strength() const
+    {
+        return 1;
+    }
+    void set(float) {}
+};
+
+// Storage policies share one shape: build() takes each person's (friend,
+// strength) pairs in ascending friend order, walk(v, f) calls
+// f(friend, strength) in that order until f returns true, and
+// walk_upper(v, f) does the same from v's first friend with a larger id.
+
+// Singly linked lists in one node pool, like graph's gnode lists. `upper`
+// points at each person's first friend with a larger id, so walk_upper()
+// starts there instead of stepping over the smaller ones.
+template <class Id, class W>
+class list_storage
+{
+    static constexpr Id end = (Id)-1;
+    vector<Id> first;
+    vector<Id> upper;
+    vector<Id> count;
+    vector<list_node<Id, W>> pool;
+
+    template <class F>
+    void walk_from(Id e, F f) const
+    {
+        for (; e != end; e = pool[e].next)
+        {
+            if (f((int)pool[e].to, pool[e].strength()))
+            {
+                return;
+            }
+        }
+    }
+
+public:
+    void build(const vector<vector<pair<int, float>>> &lists)
+    {
+        first.assign(lists.size(), end);
+        upper.assign(lists.size(), end);
+        count.resize(lists.size());
+        for (size_t v = 0; v < lists.size(); v++)
+        {
+            count[v] = (Id)lists[v].size();
+            for (size_t i = lists[v].size(); i-- > 0;)
+            {
+                list_node<Id, W> x;
+                x.to = (Id)lists[v][i].first;
+                x.next = first[v];
+                x.set(lists[v][i].second);
+                first[v] = (Id)pool.size();
+                if (lists[v][i].first > (int)v)
+                {
+                    upper[v] = first[v];
+                }
+                pool.push_back(x);
+            }
+        }
+    }
+    long edges() const
+    {
+        return (long)pool.size();
+    }
+    int degree(int v) const
+    {
+        return (int)count[v];
+    }
+    template <class F>
+    void walk(int v, F f) const
+    {
+        walk_from(first[v], f);
+    }
+    template <class F>
+    void walk_upper(int v, F f) const
+    {
+        walk_from(upper[v], f);
+    }
+    void account(memory_report &r) const
+    {
+        r.array(r.headers, first);
+        r.array(r.headers, upper);
+        r.array(r.headers, count);
+        r.array(r.adjacency, pool);
+    }
+};
+
+// Offsets into one flat id array, as in snapshot.
+template <class Id, class W>
+class csr_storage : weight_array<W>
+{
+    vector<Id> offset;
+    vector<Id> adj;
+
+    template <class F>
+    void walk_from(Id e, int v, F f) const
+    {
+        for (; e < offset[v + 1]; e++)
+        {
+            if (f((int)adj[e], this->at(e)))
+            {
+                return;
+            }
+        }
+    }
+
+public:
+    void build(const vector<vector<pair<int, float>>> &lists)
+    {
+        offset.assign(1, 0);
+        for (size_t v = 0; v < lists.size(); v++)
+        {
+            for (size_t i = 0; i < lists[v].size(); i++)
+            {
+                adj.push_back((Id)lists[v][i].first);
+                this->push(lists[v][i].second);
+            }
+            offset.push_back((Id)adj.size());
+        }
+    }
+    long edges() const
+    {
+        return (long)adj.size();
+    }
+    int degree(int v) const
+    {
+        return (int)(offset[v + 1] - offset[v]);
+    }
+    template <class F>
+    void walk(int v, F f) const
+    {
+        walk_from(offset[v], v, f);
+    }
+    // Binary search finds the first larger friend, as snapshot's upper[]
+    // would, without storing it.
+    template <class F>
+    void walk_upper(int v, F f) const
+    {
+        walk_from((Id)(upper_bound(adj.begin() + offset[v], adj.begin() + offset[v + 1], (Id)v) - adj.begin()), v, f);
+    }
+    void account(memory_report &r) const
+    {
+        r.array(r.headers, offset);
+        r.array(r.adjacency, adj);
+        weight_array<W>::account(r);
+    }
+};
+
+// Varint-coded gaps in the same format as a packed snapshot.
+template <class Id, class W>
+class packed_storage : weight_array<W>
+{
+    vector<Id> offset;
+    vector<uint64_t> packed_at;
+    vector<unsigned char> bytes;
+
+public:
+    void build(const vector<vector<pair<int, float>>> &lists)
+    {
+        offset.assign(1, 0);
+        for (size_t v = 0; v < lists.size(); v++)
+        {
+            packed_at.push_back(bytes.size());
+            for (size_t i = 0; i < lists[v].size(); i++)
+            {
+                long u = lists[v][i].first;
+                put_varint(bytes, i == 0 ? zigzag(u - (long)v) : (unsigned long)(u - lists[v][i - 1].first - 1));
+                this->push(lists[v][i].second);
+            }
+            offset.push_back(offset.back() + (Id)lists[v].size());
+        }
+        packed_at.push_back(bytes.size());
+        bytes.shrink_to_fit();
+    }
+    long edges() const
+    {
+        return (long)offset.back();
+    }
+    int degree(int v) const
+    {
+        return (int)(offset[v + 1] - offset[v]);
+    }
+    template <class F>
+    void walk(int v, F f) const
+    {
+        if (offset[v] == offset[v + 1])
+        {
+            return;
+        }
+        const unsigned char *p = &bytes[packed_at[v]];
+        long u = v + unzigzag(get_varint(p));
+        for (Id e = offset[v];; e++)
+        {
+            if (f((int)u, this->at(e)) || e + 1 == offset[v + 1])
+            {
+                return;
+            }
+            u += (long)get_varint(p) + 1;
+        }
+    }
+    // Gaps only decode forwards, so the smaller friends are still decoded,
+    // just not passed on, as in a packed snapshot.
+    template <class F>
+    void walk_upper(int v, F f) const
+    {
+        walk(v, [&](int u, float w) {
+            return u > v && f(u, w);
+        });
+    }
+    void account(memory_report &r) const
+    {
+        r.array(r.headers, offset);
+        r.array(r.adjacency, packed_at);
+        r.array(r.adjacency, bytes);
+        weight_array<W>::account(r);
+    }
+};
+
+// Immutable friend graph whose shape is fixed at compile time by the
+// policies above, so each configuration carries only what it uses: no
+// strengths without a weight type, 32-bit ids unless asked for 64, and
+// symmetric() a constant the kernels' branches fold away. It reads like a
+// snapshot, so every kernel instantiates for it as is; --self-check runs
+// hops and dijkstra over each configuration against the snapshot.
+template <class Direction, class W, class Id, template <class, class> class Storage>
+class static_graph
+{
+    static_assert(is_unsigned<Id>::value, "ids are stored unsigned");
+
+    long version;
+    bool integral;
+    vector<string> names;
+    unordered_map<string, int> index;
+    Storage<Id, W> lists;
+
+public:
+    typedef Storage<Id, W> storage;
+
+    // Copies `s`. Strengths are dropped when W is no_weight, and an
+    // undirected graph made from a directed snapshot also gets the reverse
+    // of every friendship (keeping the first strength seen for a pair).
+    explicit static_graph(const snapshot &s) : version(s.ver()), integral(true), names(s.size())
+    {
+        vector<vector<pair<int, float>>> adj(s.size());
+        for (int v = 0; v < s.size(); v++)
+        {
+            names[v] = s.name(v);
+            if (s.present(v))
+            {
+                index[names[v]] = v;
+            }
+            s.for_each_edge(v, [&](int u, float w) {
+                adj[v].push_back(make_pair(u, w));
+                if (Direction::symmetric && !s.symmetric())
+                {
+                    adj[u].push_back(make_pair(v, w));
+                }
+            });
+        }
+        for (int v = 0; v < s.size(); v++)
+        {
+            stable_sort(adj[v].begin(), adj[v].end(), [](const pair<int, float> &a, const pair<int, float> &b) {
+                return a.first < b.first;
+            });
+            adj[v].erase(unique(adj[v].begin(), adj[v].end(), [](const pair<int, float> &a, const pair<int, float> &b) {
+                             return a.first == b.first;
+                         }),
+                         adj[v].end());
+            for (size_t i = 0; i < adj[v].size(); i++)
+            {
+                float w = weight_array<W>::stored(adj[v][i].second);
+                integral = integral && w == floorf(w);
+            }
+        }
+        lists.build(adj);
+    }
+
+    static constexpr bool symmetric()
+    {
+        return Direction::symmetric;
+    }
+    static constexpr bool weighted()
+    {
+        return !is_same<W, no_weight>::value;
+    }
+    long ver() const
+    {
+        return version;
+    }
+    bool whole() const
+    {
+        return integral;
+    }
+    int size() const
+    {
+        return (int)names.size();
+    }
+    long edges() const
+    {
+        return lists.edges();
+    }
+    int degree(int v) const
+    {
+        return lists.degree(v);
+    }
+    const string &name(int v) const
+    {
+        return names[v];
+    }
+    int id(const string &who) const
+    {
+        unordered_map<string, int>::const_iterator it = index.find(who);
+        return it == index.end() ? -1 : it->second;
+    }
+    bool present(int v) const
+    {
+        return id(names[v]) == v;
+    }
+    template <class F>
+    void for_each_friend(int v, F f) const
+    {
+        lists.walk(v, [&](int u, float) {
+            f(u);
+            return false;
+        });
+    }
+    template <class F>
+    void for_each_edge(int v, F f) const
+    {
+        lists.walk(v, [&](int u, float w) {
+            f(u, w);
+            return false;
+        });
+    }
+    // Friends with a larger id, which the storage finds as it best can.
+    template <class F>
+    void for_each_upper(int v, F f) const
+    {
+        lists.walk_upper(v, [&](int u, float) {
+            f(u);
+            return false;
+        });
+    }
+    template <class P>
+    int find_friend(int v, P pred) const
+    {
+        int found = -1;
+        lists.walk(v, [&](int u, float) {
+            if (pred(u))
+            {
+                found = u;
+            }
+            return found >= 0;
+        });
+        return found;
+    }
+    memory_report memory() const
+    {
+        memory_report r;
+        r.headers = sizeof(*this);
+        r.array(r.headers, names);
+        for (size_t v = 0; v < names.size(); v++)
+        {
+            r.name(names[v]);
+        }
+        unordered_map<string, int>::const_iterator it;
+        for (it = index.begin(); it != index.end(); it++)
+        {
+            r.heap(r.headers, sizeof(void *) + sizeof(*it) + sizeof(size_t));
+            r.name(it->first);
+        }
+        r.heap(r.headers, index.bucket_count() * sizeof(void *));
+        lists.account(r);
+        r.visited = names.size() * (sizeof(char) + sizeof(int));
+        return r;
+    }
+};
+
+// Layout checks: each instantiation holds exactly what its policies ask
+// for, and nothing for the features it leaves out.
+static_assert(sizeof(list_node<uint32_t, no_weight>) == 8, "unweighted 32-bit node is two ids");
+static_assert(sizeof(list_node<uint64_t, no_weight>) == 16, "unweighted 64-bit node is two ids");
+static_assert(sizeof(list_node<uint32_t, float>) == 12, "weighted 32-bit node adds only the strength");
+static_assert(sizeof(list_node<uint32_t, unsigned char>) == 12 && sizeof(list_node<uint64_t, float>) == 24, "nodes pad to id alignment");
+static_assert(is_empty<weight_array<no_weight>>::value, "no_weight stores nothing");
+static_assert(sizeof(csr_storage<uint32_t, no_weight>) == 2 * sizeof(vector<uint32_t>), "unweighted CSR is offsets and ids only");
+static_assert(sizeof(csr_storage<uint64_t, float>) == 3 * sizeof(vector<uint64_t>), "weighted CSR adds one strength array");
+static_assert(sizeof(packed_storage<uint32_t, no_weight>) == 3 * sizeof(vector<uint32_t>), "unweighted packed lists carry no strengths");
+static_assert(sizeof(list_storage<uint32_t, float>) == 4 * sizeof(vector<uint32_t>), "list storage is heads, upper starts, counts and pool");
+static_assert(static_graph<undirected, no_weight, uint32_t, csr_storage>::symmetric() && !static_graph<undirected, no_weight, uint32_t, csr_storage>::weighted(), "policies are compile-time constants");
+static_assert(!static_graph<directed, double, uint64_t, packed_storage>::symmetric() && static_graph<directed, double, uint64_t, packed_storage>::weighted(), "policies are compile-time constants");
+static_assert(sizeof(static_graph<directed, no_weight, uint32_t, csr_storage>) < sizeof(static_graph<directed, float, uint32_t, csr_storage>), "weights cost only when used");
+
+// Pruned landmark labelling (a 2-hop cover) for exact hop distances.
+// People are taken as hubs in decreasing degree order; a BFS from each hub
+// records (hub, hops) in the labels of everyone it reaches, but stops at
+// anyone whose distance the labels made so far already answer. The
+// distance from s to t is then the best hub in both s's out-label and t's
+// in-label: a merge of two short lists sorted by hub rank. Symmetric
+// graphs need one label per person; directed ones keep separate out-labels
+// (hubs s can reach) and in-labels (hubs that reach t).
+class distance_index
+{
+    long version;
+    unsigned long print;
+    int n;
+    bool mutual;
+    vector<long> out_at;
+    vector<int> out_hub;
+    vector<unsigned short> out_dist;
+    vector<long> in_at;
+    vector<int> in_hub;
+    vector<unsigned short> in_dist;
+
+    typedef vector<vector<pair<int, unsigned short>>> labels;
+    static void flatten(labels &from, vector<long> &at, vector<int> &hub, vector<unsigned short> &dist);
+    static int meet(const int *ah, const unsigned short *ad, long an, const int *bh, const unsigned short *bd, long bn);
+
+    // Pruned BFS from `root` (rank r) over `adj`/`off`, adding (r, hops) to
+    // `to` for each person reached; `mine` is the root's own label on the
+    // other side, `theirs` the labels checked for pruning.
+    static void sweep(int root, int r, const vector<int> &off, const vector<int> &adj, labels &to, const labels &mine, const labels &theirs, vector<int> &dist, vector<int> &tmp)
+    {
+        for (size_t i = 0; i < mine[root].size(); i++)
+        {
+            tmp[mine[root][i].first] = mine[root][i].second;
+        }
+        vector<int> order(1, root);
+        dist[root] = 0;
+        for (size_t head = 0; head < order.size(); head++)
+        {
+            int v = order[head];
+            int known = INT_MAX;
+            const vector<pair<int, unsigned short>> &lv = theirs[v];
+            for (size_t i = 0; i < lv.size(); i++)
+            {
+                if (tmp[lv[i].first] != INT_MAX)
+                {
+                    known = min(known, tmp[lv[i].first] + lv[i].second);
+                }
+            }
+            if (known <= dist[v] || dist[v] >= USHRT_MAX)
+            {
+                continue;
+            }
+            to[v].push_back(make_pair(r, (unsigned short)dist[v]));
+            for (int e = off[v]; e < off[v + 1]; e++)
+            {
+                if (dist[adj[e]] < 0)
+                {
+                    dist[adj[e]] = dist[v] + 1;
+                    order.push_back(adj[e]);
+                }
+            }
+        }
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            dist[order[i]] = -1;
+        }
+        for (size_t i = 0; i < mine[root].size(); i++)
+        {
+            tmp[mine[root][i].first] = INT_MAX;
+        }
+    }
+
+public:
+    distance_index() : version(-1), print(0), n(0), mutual(false) {}
+
+    // Identity of a graph, used to match a saved index to the graph it was
+    // built from: an FNV-1a style hash of every list, degree then friend
+    // ids in order. Degrees alone would let a rewired graph with the same
+    // degree sequence pass for the old one.
+    template <class G>
+    static unsigned long fingerprint(const G &g)
+    {
+        unsigned long h = 1469598103934665603ul ^ (unsigned long)g.size();
+        h = (h ^ (g.symmetric() ? 1ul : 0ul)) * 1099511628211ul;
+        for (int v = 0; v < g.size(); v++)
+        {
+            h = (h ^ (unsigned long)g.degree(v)) * 1099511628211ul;
+            g.for_each_friend(v, [&](int u) {
+                h = (h ^ (unsigned long)u) * 1099511628211ul;
+            });
+        }
+        return h ^ (unsigned long)g.edges();
+    }
+
+    template <class G>
+    void build(const G &g, long ver)
+    {
+        STAT_PHASE(phase, "distance index build");
+        n = g.size();
+        mutual = g.symmetric();
+        version = ver;
+        print = fingerprint(g);
+
+        vector<int> off(n + 1, 0), adj, roff(n + 1, 0), radj;
+        for (int v = 0; v < n; v++)
+        {
+            g.for_each_friend(v, [&](int u) {
+                adj.push_back(u);
+                roff[u + 1]++;
+            });
+            off[v + 1] = (int)adj.size();
+        }
+        if (!mutual)
+        {
+            for (int v = 0; v < n; v++)
+            {
+                roff[v + 1] += roff[v];
+            }
+            radj.resize(adj.size());
+            vector<int> fill(roff.begin(), roff.end() - 1);
+            for (int v = 0; v < n; v++)
+            {
+                for (int e = off[v]; e < off[v + 1]; e++)
+                {
+                    radj[fill[adj[e]]++] = v;
+                }
+            }
+        }
+
+        vector<int> rank(n);
+        iota(rank.begin(), rank.end(), 0);
+        stable_sort(rank.begin(), rank.end(), [&](int a, int b) {
+            return g.degree(a) > g.degree(b);
+        });
+        labels out(n), in(mutual ? 0 : n);
+        vector<int> dist(n, -1), tmp(n, INT_MAX);
+        for (int r = 0; r < n; r++)
+        {
+            int h = rank[r];
+            if (mutual)
+            {
+                sweep(h, r, off, adj, out, out, out, dist, tmp);
+                continue;
+            }
+            // Forward: h reaches v, so (r, d) joins v's in-label.
+            sweep(h, r, off, adj, in, out, in, dist, tmp);
+            // Backward: v reaches h, so (r, d) joins v's out-label.
+            sweep(h, r, roff, radj, out, in, out, dist, tmp);
+        }
+        flatten(out, out_at, out_hub, out_dist);
+        flatten(in, in_at, in_hub, in_dist);
+    }
+
+    bool ready_for(long ver) const
+    {
+        return version == ver;
+    }
+    // Hops from s to t, or -1 if t can't be reached.
+    int distance(int s, int t) const
+    {
+        const vector<long> &at = mutual ? out_at : in_at;
+        const vector<int> &hub = mutual ? out_hub : in_hub;
+        const vector<unsigned short> &dist = mutual ? out_dist : in_dist;
+        return meet(out_hub.data() + out_at[s], out_dist.data() + out_at[s], out_at[s + 1] - out_at[s],
+                    hub.data() + at[t], dist.data() + at[t], at[t + 1] - at[t]);
+    }
+    size_t entries() const
+    {
+        return out_hub.size() + in_hub.size();
+    }
+    bool save(const string &path) const;
+    bool load(const string &path, unsigned long expected, long ver);
+};
+
+// LRU cache of traversal orders keyed by (start, algorithm, graph version)
+// and held under a byte budget. The version is the owner's mutation
+// counter, so an edit makes every older entry unreachable; the first
+// lookup at a newer version drops them all rather than letting them age
+// out. Safe to share between threads.
+class traversal_cache
+{
+    struct key
+    {
+        int start;
+        char algo;
+        long version;
+
+        bool operator==(const key &o) const
+        {
+            return start == o.start && algo == o.algo && version == o.version;
+        }
+    };
+    struct key_hash
+    {
+        size_t operator()(const key &k) const
+        {
+            return ((size_t)k.version * 31 + (size_t)k.algo) * 1000003 + (size_t)k.start;
+        }
+    };
+    typedef pair<key, shared_ptr<const vector<int>>> entry;
+
+    list<entry> lru;
+    unordered_map<key, list<entry>::iterator, key_hash> at;
+    size_t budget;
+    size_t used;
+    long latest;
+    long hits;
+    long misses;
+    long evictions;
+    long invalidations;
+    mutable mutex lock;
+
+    static size_t cost(const vector<int> &order)
+    {
+        return order.size() * sizeof(int) + sizeof(entry) + sizeof(vector<int>) + 4 * sizeof(void *);
+    }
+    // Must hold `lock`.
+    void forget(long version)
+    {
+        if (version > latest)
+        {
+            invalidations += (long)lru.size();
+            lru.clear();
+            at.clear();
+            used = 0;
+            latest = version;
+        }
+    }
+    // Must hold `lock`.
+    void trim()
+    {
+        while (used > budget && !lru.empty())
+        {
+            used -= cost(*lru.back().second);
+            at.erase(lru.back().first);
+            lru.pop_back();
+            evictions++;
+        }
+    }
+
+public:
+    traversal_cache(size_t bytes) : budget(bytes), used(0), latest(0), hits(0), misses(0), evictions(0), invalidations(0) {}
+
+    shared_ptr<const vector<int>> find(int start, char algo, long version)
+    {
+        lock_guard<mutex> hold(lock);
+        forget(version);
+        key k = {start, algo, version};
+        unordered_map<key, list<entry>::iterator, key_hash>::iterator it = at.find(k);
+        if (it == at.end())
+        {
+            misses++;
+            return shared_ptr<const vector<int>>();
+        }
+        hits++;
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->second;
+    }
+    void put(int start, char algo, long version, const vector<int> &order)
+    {
+        lock_guard<mutex> hold(lock);
+        forget(version);
+        key k = {start, algo, version};
+        if (version < latest || at.count(k) || cost(order) > budget)
+        {
+            return;
+        }
+        lru.push_front(make_pair(k, make_shared<const vector<int>>(order)));
+        at[k] = lru.begin();
+        used += cost(order);
+        trim();
+    }
+    void limit(size_t bytes)
+    {
+        lock_guard<mutex> hold(lock);
+        budget = bytes;
+        trim();
+    }
+    void print() const
+    {
+        lock_guard<mutex> hold(lock);
+        cout << "\nCached traversals: " << lru.size() << " using " << used << " of " << budget << " bytes";
+        cout << "\nHits: " << hits << "  Misses: " << misses;
+        cout << "\nEvicted: " << evictions << "  Invalidated: " << invalidations << "\n";
+    }
+};
+
+// CRC-32 (IEEE) of `len` bytes, continuing from `crc`.
+unsigned crc32(const char *p, size_t len, unsigned crc = 0)
+{
+    static unsigned table[256];
+    static once_flag filled;
+    call_once(filled, [&]() {
+        for (unsigned i = 0; i < 256; i++)
+        {
+            unsigned c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+    });
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = table[(crc ^ (unsigned char)p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Append-only log of committed deltas, plus the checkpoint it is replayed
+// on top of. A record is
+//     length (4 bytes), CRC-32 of what follows (4), sequence (8), delta
+// and the checkpoint at <path>.snap is "GSNAP1", a CRC-32, the sequence
+// of the last record it includes, the mutual/strengths flags and the
+// whole graph as one delta. Recovery loads the checkpoint, replays the
+// records after its sequence and cuts the log at the first torn or
+// corrupt one, so restart costs the log tail rather than the whole
+// history.
+//
+// Commits are grouped: append() only buffers, and a flusher thread writes
+// and fdatasyncs whatever has piled up since its last sync. A committer
+// blocks in wait() until its record is on disk, so everyone who appended
+// during one sync shares the next.
+class write_ahead_log
+{
+    int fd;
+    string path;
+    string buffer;
+    long appended;
+    long durable;
+    long bytes;
+    long base;
+    long syncs;
+    bool closing;
+    bool failed;
+    mutex lock;
+    condition_variable work;
+    condition_variable synced;
+    thread flusher;
+
+    template <typename T>
+    static void put(string &out, T x)
+    {
+        out.append((const char *)&x, sizeof(x));
+    }
+    template <typename T>
+    static bool get(const char *&p, const char *end, T &x)
+    {
+        if ((size_t)(end - p) < sizeof(x))
+        {
+            return false;
+        }
+        memcpy(&x, p, sizeof(x));
+        p += sizeof(x);
+        return true;
+    }
+    static void encode(const delta &d, string &out)
+    {
+        put(out, (unsigned)d.people.size());
+        for (size_t i = 0; i < d.people.size(); i++)
+        {
+            put(out, (unsigned)d.people[i].size());
+            out += d.people[i];
+        }
+        put(out, (unsigned)d.friendships.size());
+        out.append((const char *)d.friendships.data(), d.friendships.size() * sizeof(d.friendships[0]));
+        put(out, (unsigned)d.strength.size());
+        out.append((const char *)d.strength.data(), d.strength.size() * sizeof(float));
+        put(out, (unsigned)d.unfriended.size());
+        out.append((const char *)d.unfriended.data(), d.unfriended.size() * sizeof(d.unfriended[0]));
+        put(out, (unsigned)d.departed.size());
+        out.append((const char *)d.departed.data(), d.departed.size() * sizeof(int));
+        put(out, (unsigned)d.formed.size());
+        out.append((const char *)d.formed.data(), d.formed.size() * sizeof(long));
+    }
+    static bool decode(const char *p, const char *end, delta &d)
+    {
+        auto array = [&](auto &v) {
+            unsigned count;
+            if (!get(p, end, count) || (size_t)(end - p) / sizeof(v[0]) < count)
+            {
+                return false;
+            }
+            v.resize(count);
+            if (count > 0)
+            {
+                memcpy((void *)v.data(), p, count * sizeof(v[0]));
+            }
+            p += count * sizeof(v[0]);
+            return true;
+        };
+        unsigned people;
+        if (!get(p, end, people))
+        {
+            return false;
+        }
+        for (unsigned i = 0; i < people; i++)
+        {
+            unsigned len;
+            if (!get(p, end, len) || (size_t)(end - p) < len)
+            {
+                return false;
+            }
+            d.people.push_back(string(p, len));
+            p += len;
+        }
+        // Records from before friendships had times stop after `departed`.
+        return array(d.friendships) && array(d.strength) && array(d.unfriended) && array(d.departed) && (p == end || array(d.formed)) && p == end;
+    }
+    static bool write_all(int to, const char *p, size_t len)
+    {
+        while (len > 0)
+        {
+            ssize_t k = write(to, p, len);
+            if (k < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (k <= 0)
+            {
+                return false;
+            }
+            p += k;
+            len -= k;
+        }
+        return true;
+    }
+    void flush_loop()
+    {
+        unique_lock<mutex> hold(lock);
+        while (true)
+        {
+            work.wait(hold, [&]() { return closing || !buffer.empty(); });
+            if (buffer.empty())
+            {
+                return;
+            }
+            string batch;
+            batch.swap(buffer);
+            long upto = appended;
+            hold.unlock();
+            bool ok = write_all(fd, batch.data(), batch.size()) && fdatasync(fd) == 0;
+            hold.lock();
+            failed = failed || !ok;
+            durable = upto;
+            syncs++;
+            synced.notify_all();
+        }
+    }
+    void stop()
+    {
+        if (flusher.joinable())
+        {
+            {
+                lock_guard<mutex> hold(lock);
+                closing = true;
+            }
+            work.notify_all();
+            flusher.join();
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+public:
+    write_ahead_log() : fd(-1), appended(0), durable(0), bytes(0), base(0), syncs(0), closing(false), failed(false) {}
+    ~write_ahead_log()
+    {
+        stop();
+    }
+
+    static bool saved(const string &path)
+    {
+        return !path.empty() && access((path + ".snap").c_str(), F_OK) == 0;
+    }
+    // Reads the mutual/strengths flags the checkpoint at `path` was made with.
+    static bool flags(const string &path, bool &mutual, bool &strengths)
+    {
+        ifstream in((path + ".snap").c_str(), ios::binary);
+        char head[6 + sizeof(unsigned) + sizeof(long) + 1];
+        if (!in.read(head, sizeof(head)) || memcmp(head, "GSNAP1", 6) != 0)
+        {
+            return false;
+        }
+        mutual = head[sizeof(head) - 1] & 1;
+        strengths = head[sizeof(head) - 1] & 2;
+        return true;
+    }
+
+    // Loads the checkpoint and every intact record after it into `state`
+    // and `tail`, truncates any torn end, and opens the log for appends.
+    // With no checkpoint on disk it starts an empty log instead.
+    bool open(const string &at, delta &state, vector<delta> &tail)
+    {
+        path = at;
+        long seq = 0;
+        if (saved(path))
+        {
+            ifstream in((path + ".snap").c_str(), ios::binary);
+            string file((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            const char *p = file.data(), *end = p + file.size();
+            unsigned crc;
+            unsigned char flags;
+            base = file.size();
+            if (file.size() < 6 || memcmp(p, "GSNAP1", 6) != 0)
+            {
+                return false;
+            }
+            p += 6;
+            if (!get(p, end, crc) || crc != crc32(p, end - p) || !get(p, end, seq) || !get(p, end, flags) || !decode(p, end, state))
+            {
+                return false;
+            }
+        }
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | (saved(path) ? 0 : O_TRUNC), 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+        string log;
+        char chunk[1 << 16];
+        ssize_t k;
+        while ((k = read(fd, chunk, sizeof(chunk))) > 0)
+        {
+            log.append(chunk, k);
+        }
+        const char *p = log.data(), *end = p + log.size();
+        long last = seq;
+        while (true)
+        {
+            const char *start = p;
+            unsigned len, crc;
+            long at_seq;
+            delta d;
+            if (!get(p, end, len) || !get(p, end, crc) || (size_t)(end - p) < len || crc32(p, len) != crc || !get(p, p + len, at_seq) || !decode(p, start + 8 + len, d))
+            {
+                p = start;
+                break;
+            }
+            p = start + 8 + len;
+            if (at_seq > seq)
+            {
+                tail.push_back(d);
+                last = at_seq;
+            }
+        }
+        bytes = p - log.data();
+        if (bytes < (long)log.size() && (ftruncate(fd, bytes) != 0 || fsync(fd) != 0))
+        {
+            return false;
+        }
+        lseek(fd, bytes, SEEK_SET);
+        appended = durable = last;
+        flusher = thread(&write_ahead_log::flush_loop, this);
+        return true;
+    }
+    bool is_open() const
+    {
+        return fd >= 0;
+    }
+    // Stops logging without writing anything more; the files stay as
+    // they are.
+    void abandon()
+    {
+        stop();
+    }
+
+    // Queues `d` for the next group commit and returns its sequence.
+    long append(const delta &d)
+    {
+        string body;
+        put(body, 0L);
+        encode(d, body);
+        lock_guard<mutex> hold(lock);
+        memcpy(&body[0], &++appended, sizeof(long));
+        put(buffer, (unsigned)body.size());
+        put(buffer, crc32(body.data(), body.size()));
+        buffer += body;
+        bytes += 8 + body.size();
+        work.notify_one();
+        return appended;
+    }
+    // Blocks until record `seq` is durable; false if a write or sync failed.
+    bool wait(long seq)
+    {
+        unique_lock<mutex> hold(lock);
+        synced.wait(hold, [&]() { return durable >= seq; });
+        return !failed;
+    }
+    long size()
+    {
+        lock_guard<mutex> hold(lock);
+        return bytes;
+    }
+    // True once the log has outgrown the checkpoint, so replaying it would
+    // cost more than reading a fresh one.
+    bool due()
+    {
+        lock_guard<mutex> hold(lock);
+        return bytes > max(1L << 16, base);
+    }
+    long sync_count()
+    {
+        lock_guard<mutex> hold(lock);
+        return syncs;
+    }
+
+    // Writes `state`, which must include every record appended so far, as
+    // the new checkpoint and empties the log. The checkpoint is renamed
+    // into place before the log is cut, so a crash in between just replays
+    // records the checkpoint already covers and skips them by sequence.
+    bool checkpoint(const delta &state, bool mutual, bool strengths)
+    {
+        unique_lock<mutex> hold(lock);
+        synced.wait(hold, [&]() { return durable >= appended; });
+        string body;
+        put(body, appended);
+        put(body, (unsigned char)((mutual ? 1 : 0) | (strengths ? 2 : 0)));
+        encode(state, body);
+        string file = "GSNAP1";
+        put(file, crc32(body.data(), body.size()));
+        file += body;
+        string temp = path + ".snap.tmp";
+        int out = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool ok = out >= 0 && write_all(out, file.data(), file.size()) && fsync(out) == 0;
+        if (out >= 0)
+        {
+            close(out);
+        }
+        ok = ok && rename(temp.c_str(), (path + ".snap").c_str()) == 0;
+        size_t slash = path.rfind('/');
+        int dir = ::open(slash == string::npos ? "." : path.substr(0, slash + 1).c_str(), O_RDONLY);
+        if (dir >= 0)
+        {
+            ok = fsync(dir) == 0 && ok;
+            close(dir);
+        }
+        if (!ok || ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) != 0 || fdatasync(fd) != 0)
+        {
+            return false;
+        }
+        bytes = 0;
+        base = file.size();
+        return true;
+    }
+};
+
+class graph
+{
+private:
+    gnode *head[20];
+    int n;
+    int visit[20];
+    bool undirected;
+    bool weighted;
+    snapshot_store published;
+    delta pending;
+    distance_index hop_index;
+
+    // Removed friendships and people are tombstoned in place and skipped by
+    // the traversals; compact() unlinks them once the dead share of all
+    // listed friendships reaches compact_at. links[] counts each person's
+    // live friendships in both directions, so removing someone can estimate
+    // how many list entries died without walking the other lists.
+    unordered_map<long, gnode *> edge_at;
+    int links[20];
+    long total_edges;
+    long dead_edges;
+    double compact_at;
+    bool background;
+    bool compacting;
+    mutex lists;
+    thread compactor;
+
+    // Bumped by every edit that changes what a traversal would print; the
+    // cache keys on it.
+    long mutations;
+    traversal_cache walks;
+    vector<int> trail;
+    bool replay(int x, char algo);
+
+    // Every commit is logged here first when the graph was started with a
+    // log; see write_ahead_log.
+    write_ahead_log journal;
+    void restore(const string &log);
+    bool apply(const delta &d);
+    void depart(int x);
+    delta state();
+    void checkpoint();
+
+    static long key(int a, int b)
+    {
+        return (long)a << 32 | (unsigned)b;
+    }
+    bool gone(gnode *e)
+    {
+        return e->dead || head[e->id]->dead;
+    }
+    bool tombstone(int a, int b);
+    void maybe_compact();
+
+public:
+    graph(bool mutual = false, bool strengths = false, const string &log = "") : undirected(mutual), weighted(strengths), published(mutual), total_edges(0), dead_edges(0), compact_at(0.25), background(true), compacting(false), mutations(0), walks(1 << 20)
+    {
+        if (write_ahead_log::saved(log))
+        {
+            restore(log);
+            return;
+        }
+        delta none;
+        vector<delta> tail;
+        if (!log.empty() && !journal.open(log, none, tail))
+        {
+            cout << "Can't open " << log << "\n";
+        }
+        cout << "Number of people? ";
+        cin >> n;
+        for (int i = 0; i < n; i++)
+        {
+            head[i] = new gnode;
+            cout << "Enter name of person " << i << "\n";
+            cin >> head[i]->name;
+            head[i]->id = i;
+            head[i]->dead = false;
+            head[i]->weight = 0;
+            head[i]->formed = 0;
+            head[i]->next = NULL;
+            links[i] = 0;
+            pending.people.push_back(head[i]->name);
+        }
+        commit();
+        if (journal.is_open())
+        {
+            checkpoint();
+        }
+    }
+    ~graph()
+    {
+        if (compactor.joinable())
+        {
+            compactor.join();
+        }
+        if (journal.is_open() && journal.size() > 0)
+        {
+            checkpoint();
+        }
+    }
+
+    void create();
+    void display();
+    void dfs_r();
+    void dfs_r(string v);
+    void dfs_nr();
+    void bfs();
+    int isthere(string fren);
+    int where(string fren);
+    void link(int a, int b, float w = 1, long t = 0);
+    void commit();
+    void path();
+    void groups();
+    void triangles();
+    void unfriend();
+    void remove();
+    void compact();
+    void weighted_path();
+    memory_report memory();
+    void usage();
+    void reach();
+    void suggest();
+    void bridges();
+    void communities_of();
+    void hop_distance();
+    void circles();
+    void reach_estimates();
+    void export_graph();
+    void random_walks();
+    void over_time();
+    void similar_people();
+    void core_groups();
+    void explore_circle();
+    void cache_stats()
+    {
+        walks.print();
+    }
+    void cache_budget(size_t bytes)
+    {
+        walks.limit(bytes);
+    }
+    // Compact once dead entries reach `at` of all list entries, on the
+    // compactor thread or, if not in_background, inside the removal that
+    // crossed the line.
+    void compaction(double at, bool in_background)
+    {
+        lock_guard<mutex> hold(lists);
+        compact_at = at;
+        background = in_background;
+    }
+    bool logging() const
+    {
+        return journal.is_open();
+    }
+    snapshot_store::reader pin()
+    {
+        return published.pin();
+    }
+};
+
+class stack
+{
+    int top;
+    string data[30];
+
+public:
+    stack()
+    {
+        top = -1;
+    }
+
+    void push(string temp)
+    {
+        top++;
+        data[top] = temp;
+    }
+
+    string pop()
+    {
+        string temp = data[top];
+        top--;
+        return temp;
+    }
+    int empty;
+    friend class graph;
+};
+
+class queue
+{
+    int front;
+    int rear;
+    string q[10];
+
+public:
+    queue()
+    {
+        front = -1;
+        rear = -1;
+    }
+    void enqueue(string temp)
+    {
+        rear++;
+        q[rear] = temp;
+    }
+    string dequeue()
+    {
+        front++;
+        string temp = q[front];
+        return temp;
+    }
+    friend class graph;
+};
+
+snapshot *snapshot::apply(const snapshot &base, const delta &d)
+{
+    snapshot *next = new snapshot;
+    next->version = base.version + 1;
+    next->mutual = base.mutual;
+    next->packed = base.packed;
+    next->names = base.names;
+    next->index = base.index;
+    for (size_t i = 0; i < d.people.size(); i++)
+    {
+        next->index[d.people[i]] = (int)next->names.size();
+        next->names.push_back(d.people[i]);
+    }
+    int n = next->size();
+
+    vector<char> left(n, 0);
+    for (size_t i = 0; i < d.departed.size(); i++)
+    {
+        int v = d.departed[i];
+        if (v >= 0 && v < n && !left[v])
+        {
+            left[v] = 1;
+            next->index.erase(next->names[v]);
+        }
+    }
+    vector<pair<int, int>> cut = d.unfriended;
+    if (next->mutual)
+    {
+        for (size_t i = 0; i < d.unfriended.size(); i++)
+        {
+            cut.push_back(make_pair(d.unfriended[i].second, d.unfriended[i].first));
+        }
+    }
+    sort(cut.begin(), cut.end());
+
+    bool weighted = !base.weight.empty() || !d.strength.empty();
+    bool timed = !base.stamp.empty() || !d.formed.empty();
+    vector<arc> add;
+    for (size_t i = 0; i < d.friendships.size(); i++)
+    {
+        int u = d.friendships[i].first, w = d.friendships[i].second;
+        float x = i < d.strength.size() ? d.strength[i] : 1;
+        long t = i < d.formed.size() ? d.formed[i] : 0;
+        if (u >= 0 && u < n && w >= 0 && w < n && u != w)
+        {
+            add.push_back(arc(u, w, x, t));
+            if (next->mutual)
+            {
+                add.push_back(arc(w, u, x, t));
+            }
+        }
+    }
+    stable_sort(add.begin(), add.end());
+
+    next->offset.assign(n + 1, 0);
+    next->adj.reserve(base.adj.size() + add.size());
+    size_t k = 0, r = 0;
+    vector<int> old;
+    for (int v = 0; v < n; v++)
+    {
+        int e = v < base.size() ? base.offset[v] : 0;
+        int end = v < base.size() ? base.offset[v + 1] : 0;
+        int start = e;
+        old.clear();
+        if (v < base.size())
+        {
+            base.for_each_friend(v, [&](int u) {
+                old.push_back(u);
+            });
+        }
+        while (e < end || (k < add.size() && add[k].from == v))
+        {
+            int u;
+            float x;
+            long t;
+            if (k < add.size() && add[k].from == v && (e == end || add[k].to <= old[e - start]))
+            {
+                if (e < end && old[e - start] == add[k].to)
+                {
+                    e++;
+                }
+                // The latest strength and time given for a friendship win.
+                while (k + 1 < add.size() && add[k + 1].from == v && add[k + 1].to == add[k].to)
+                {
+                    k++;
+                }
+                u = add[k].to;
+                t = add[k].formed;
+                x = add[k++].weight;
+            }
+            else
+            {
+                x = base.weight.empty() ? 1 : base.weight[e];
+                t = base.stamp.empty() ? 0 : base.stamp[e];
+                u = old[e++ - start];
+            }
+            while (r < cut.size() && cut[r] < make_pair(v, u))
+            {
+                r++;
+            }
+            if (!left[v] && !left[u] && (r == cut.size() || cut[r] != make_pair(v, u)))
+            {
+                next->adj.push_back(u);
+                if (weighted)
+                {
+                    next->weight.push_back(x);
+                }
+                if (timed)
+                {
+                    next->stamp.push_back(t);
+                }
+            }
+        }
+        next->offset[v + 1] = (int)next->adj.size();
+    }
+    next->finish();
+    return next;
+}
+
+// First version of a store, from a delta that only adds people and
+// friendships, built by a parallel counting sort instead of apply()'s sort
+// and merge. Threads count list lengths, prefix sums cut the arc array,
+// every arc lands in its list through an atomic cursor, and each list is
+// then sorted and deduplicated on its own. The result matches apply()'s,
+// latest strength and time for a repeated friendship included.
+snapshot *snapshot::build(const snapshot &base, const delta &d, int threads)
+{
+    STAT_PHASE(phase, "bulk snapshot build");
+    threads = max(threads, 1);
+    snapshot *next = new snapshot;
+    next->version = base.version + 1;
+    next->mutual = base.mutual;
+    next->packed = base.packed;
+    next->names = d.people;
+    next->index.reserve(d.people.size());
+    for (size_t i = 0; i < d.people.size(); i++)
+    {
+        next->index[d.people[i]] = (int)i;
+    }
+    int n = next->size();
+    long m = (long)d.friendships.size();
+    bool weighted = !d.strength.empty();
+    bool timed = !d.formed.empty();
+    auto valid = [&](long i) {
+        int u = d.friendships[i].first, w = d.friendships[i].second;
+        return u >= 0 && u < n && w >= 0 && w < n && u != w;
+    };
+
+    vector<atomic<int>> fill(n);
+    run_on_threads(threads, [&](int t) {
+        for (long i = m * t / threads; i < m * (t + 1) / threads; i++)
+        {
+            if (valid(i))
+            {
+                fill[d.friendships[i].first].fetch_add(1, memory_order_relaxed);
+                if (next->mutual)
+                {
+                    fill[d.friendships[i].second].fetch_add(1, memory_order_relaxed);
+                }
+            }
+        }
+    });
+    vector<int> start(n + 1, 0);
+    for (int v = 0; v < n; v++)
+    {
+        start[v + 1] = start[v] + fill[v].load(memory_order_relaxed);
+        fill[v].store(start[v], memory_order_relaxed);
+    }
+
+    // Each slot holds the index of the friendship that put it there, so
+    // ties sort by input order and the latest one can win.
+    vector<int> slot(start[n]);
+    run_on_threads(threads, [&](int t) {
+        for (long i = m * t / threads; i < m * (t + 1) / threads; i++)
+        {
+            if (valid(i))
+            {
+                slot[fill[d.friendships[i].first].fetch_add(1, memory_order_relaxed)] = (int)i;
+                if (next->mutual)
+                {
+                    slot[fill[d.friendships[i].second].fetch_add(1, memory_order_relaxed)] = (int)i;
+                }
+            }
+        }
+    });
+    vector<atomic<int>>().swap(fill);
+
+    // Sort each list by friend, keep the last entry per friend and move the
+    // survivors to the front of the list's range as friend ids.
+    vector<float> strength(weighted ? slot.size() : 0);
+    vector<long> formed(timed ? slot.size() : 0);
+    vector<int> kept(n + 1, 0);
+    atomic<int> cursor(0);
+    run_on_threads(threads, [&](int) {
+        for (int first; (first = cursor.fetch_add(1024)) < n;)
+        {
+            for (int v = first; v < min(first + 1024, n); v++)
+            {
+                auto other = [&](int i) {
+                    return d.friendships[i].first == v ? d.friendships[i].second : d.friendships[i].first;
+                };
+                sort(slot.begin() + start[v], slot.begin() + start[v + 1], [&](int a, int b) {
+                    int x = other(a), y = other(b);
+                    return x != y ? x < y : a < b;
+                });
+                int out = start[v];
+                for (int e = start[v]; e < start[v + 1]; e++)
+                {
+                    int i = slot[e], u = other(i);
+                    if (e + 1 < start[v + 1] && other(slot[e + 1]) == u)
+                    {
+                        continue;
+                    }
+                    if (weighted)
+                    {
+                        strength[out] = (size_t)i < d.strength.size() ? d.strength[i] : 1;
+                    }
+                    if (timed)
+                    {
+                        formed[out] = (size_t)i < d.formed.size() ? d.formed[i] : 0;
+                    }
+                    slot[out++] = u;
+                }
+                kept[v + 1] = out - start[v];
+            }
+        }
+    });
+    next->offset.assign(n + 1, 0);
+    for (int v = 0; v < n; v++)
+    {
+        next->offset[v + 1] = next->offset[v] + kept[v + 1];
+    }
+    next->adj.resize(next->offset[n]);
+    next->weight.resize(weighted ? next->offset[n] : 0);
+    next->stamp.resize(timed ? next->offset[n] : 0);
+    cursor.store(0);
+    run_on_threads(threads, [&](int) {
+        for (int first; (first = cursor.fetch_add(1024)) < n;)
+        {
+            for (int v = first; v < min(first + 1024, n); v++)
+            {
+                copy(slot.begin() + start[v], slot.begin() + start[v] + kept[v + 1], next->adj.begin() + next->offset[v]);
+                if (weighted)
+                {
+                    copy(strength.begin() + start[v], strength.begin() + start[v] + kept[v + 1], next->weight.begin() + next->offset[v]);
+                }
+                if (timed)
+                {
+                    copy(formed.begin() + start[v], formed.begin() + start[v] + kept[v + 1], next->stamp.begin() + next->offset[v]);
+                }
+            }
+        }
+    });
+    next->finish();
+    return next;
+}
+
+// Derived state shared by apply() and build(): whether every strength is
+// whole, where symmetric lists pass their own id, the lists in time order
+// and the packed form.
+void snapshot::finish()
+{
+    int n = size();
+    if (!stamp.empty())
+    {
+        when.resize(stamp.size());
+        by_time.resize(stamp.size());
+        vector<int> order;
+        for (int v = 0; v < n; v++)
+        {
+            order.resize(offset[v + 1] - offset[v]);
+            iota(order.begin(), order.end(), offset[v]);
+            stable_sort(order.begin(), order.end(), [&](int a, int b) {
+                return stamp[a] < stamp[b];
+            });
+            for (size_t i = 0; i < order.size(); i++)
+            {
+                when[offset[v] + i] = stamp[order[i]];
+                by_time[offset[v] + i] = adj[order[i]];
+            }
+        }
+    }
+    integral = true;
+    for (size_t e = 0; e < weight.size() && integral; e++)
+    {
+        integral = weight[e] == (float)(long)weight[e];
+    }
+    if (mutual)
+    {
+        upper.resize(n);
+        for (int v = 0; v < n; v++)
+        {
+            upper[v] = (int)(upper_bound(adj.begin() + offset[v], adj.begin() + offset[v + 1], v) - adj.begin());
+        }
+    }
+    if (packed)
+    {
+        pack();
+    }
+}
+
+// Vertex headers are the names table, the name index and the offsets; the
+// visited figure is what one traversal allocates (a flag and a queue slot
+// per person).
+memory_report snapshot::memory() const
+{
+    memory_report r;
+    r.headers = sizeof(snapshot);
+    r.array(r.headers, names);
+    r.array(r.headers, offset);
+    r.array(r.headers, upper);
+    for (size_t v = 0; v < names.size(); v++)
+    {
+        r.name(names[v]);
+    }
+    unordered_map<string, int>::const_iterator it;
+    for (it = index.begin(); it != index.end(); it++)
+    {
+        r.heap(r.headers, sizeof(void *) + sizeof(*it) + sizeof(size_t));
+        r.name(it->first);
+    }
+    r.heap(r.headers, index.bucket_count() * sizeof(void *));
+    r.array(r.adjacency, adj);
+    r.array(r.adjacency, weight);
+    r.array(r.adjacency, stamp);
+    r.array(r.adjacency, when);
+    r.array(r.adjacency, by_time);
+    r.array(r.adjacency, packed_at);
+    r.array(r.adjacency, bytes);
+    r.visited = names.size() * (sizeof(char) + sizeof(int));
+    return r;
+}
+
+// Rough footprint of a snapshot of the given shape, for planning before a
+// load. Packed lists are assumed to average `packed_bytes` per friendship.
+memory_report estimate_memory(long people, long friendships, double name_length, bool weighted, bool compressed, double packed_bytes = 2)
+{
+    memory_report r;
+    size_t n = people, m = friendships, len = (size_t)name_length;
+    size_t node = sizeof(void *) + sizeof(pair<const string, int>) + sizeof(size_t);
+    r.headers = sizeof(snapshot) + n * (sizeof(string) + sizeof(int)) + n * sizeof(void *);
+    r.slack = (memory_report::block(node) - node) * n;
+    r.headers += n * node;
+    if (len > string().capacity())
+    {
+        r.names = 2 * n * (len + 1);
+        r.slack += 2 * n * (memory_report::block(len + 1) - len - 1);
+    }
+    r.names_without_sso = 2 * n * memory_report::block(len + 1);
+    r.adjacency = compressed ? (size_t)(m * packed_bytes) + (n + 1) * sizeof(long) : m * sizeof(int);
+    if (weighted)
+    {
+        r.adjacency += m * sizeof(float);
+    }
+    r.visited = n * (sizeof(char) + sizeof(int));
+    return r;
+}
+
+void memory_report::print(const char *title) const
+{
+    cout << "\n"
+         << title << "\n";
+    cout << "  vertex headers:   " << headers << " bytes\n";
+    cout << "  adjacency:        " << adjacency << " bytes\n";
+    cout << "  names:            " << names << " bytes (" << names_without_sso << " without SSO)\n";
+    cout << "  visited arrays:   " << visited << " bytes\n";
+    cout << "  allocator slack:  " << slack << " bytes\n";
+    cout << "  total:            " << total() << " bytes\n";
+}
+
+// Re-encodes `adj` into `bytes` and releases it.
+void snapshot::pack()
+{
+    int n = size();
+    packed_at.assign(n + 1, 0);
+    bytes.clear();
+    for (int v = 0; v < n; v++)
+    {
+        packed_at[v] = (long)bytes.size();
+        for (int e = offset[v]; e < offset[v + 1]; e++)
+        {
+            put_varint(bytes, e == offset[v] ? zigzag(adj[e] - (long)v) : (unsigned long)(adj[e] - (long)adj[e - 1] - 1));
+        }
+    }
+    packed_at[n] = (long)bytes.size();
+    bytes.shrink_to_fit();
+    vector<int>().swap(adj);
+}
+
+snapshot_store::snapshot_store(bool symmetric, bool compressed) : current(new snapshot(symmetric, compressed)), epoch(1), waiting(0) {}
+
+snapshot_store::~snapshot_store()
+{
+    delete current.load();
+    for (size_t i = 0; i < retired.size(); i++)
+    {
+        delete retired[i].second;
+    }
+    for (slot_block *b = slots.next.load(); b != NULL;)
+    {
+        slot_block *next = b->next.load();
+        delete b;
+        b = next;
+    }
+}
+
+snapshot_store::reader snapshot_store::pin()
+{
+    for (slot_block *b = &slots;;)
+    {
+        for (int i = 0; i < SLOTS; i++)
+        {
+            unsigned long idle = 0;
+            unsigned long e = epoch.load();
+            if (b->slot[i].compare_exchange_strong(idle, e))
+            {
+                return reader(this, &b->slot[i], current.load());
+            }
+        }
+        slot_block *more = b->next.load();
+        if (more == NULL)
+        {
+            slot_block *grown = new slot_block();
+            if (b->next.compare_exchange_strong(more, grown))
+            {
+                more = grown;
+            }
+            else
+            {
+                delete grown;
+            }
+        }
+        b = more;
+    }
+}
+
+// Frees what the reader was holding back if nothing else is, unless a
+// publish is under way, which will reclaim it anyway.
+void snapshot_store::unpin(atomic<unsigned long> *at)
+{
+    at->store(0);
+    if (waiting.load() > 0 && writer.try_lock())
+    {
+        reclaim();
+        writer.unlock();
+    }
+}
+
+// A first load that only adds people and friendships takes build()'s
+// parallel path with `threads` workers.
+long snapshot_store::publish(const delta &d, int threads)
+{
+    lock_guard<mutex> hold(writer);
+    const snapshot *old = current.load();
+    if (d.empty())
+    {
+        return old->ver();
+    }
+    bool fresh = old->size() == 0 && d.unfriended.empty() && d.departed.empty();
+    const snapshot *next = fresh ? snapshot::build(*old, d, threads) : snapshot::apply(*old, d);
+    current.store(next);
+    retired.push_back(make_pair(epoch.fetch_add(1), old));
+    reclaim();
+    return next->ver();
+}
+
+// Must hold `writer`. A version retired at epoch e may still be read by any
+// slot pinned at an epoch <= e.
+void snapshot_store::reclaim()
+{
+    unsigned long oldest = epoch.load();
+    for (const slot_block *b = &slots; b != NULL; b = b->next.load())
+    {
+        for (int i = 0; i < SLOTS; i++)
+        {
+            unsigned long e = b->slot[i].load();
+            if (e != 0 && e < oldest)
+            {
+                oldest = e;
+            }
+        }
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); i++)
+    {
+        if (retired[i].first < oldest)
+        {
+            delete retired[i].second;
+        }
+        else
+        {
+            retired[kept++] = retired[i];
+        }
+    }
+    retired.resize(kept);
+    waiting.store(kept);
+}
+
+// Hop counts from s on any id-based graph; -1 where unreachable. Runs level
+// by level; on symmetric graphs a level whose frontier touches more than
+// 1/14 of the unexplored friendships is done bottom-up instead (each
+// unreached person looks for any friend in the frontier), until the
+// frontier shrinks below 1/24 of everyone.
+template <class G>
+vector<int> hops(const G &g, int s)
+{
+    int n = g.size();
+    vector<int> dist(n, -1);
+    vector<int> frontier(1, s), next;
+    dist[s] = 0;
+    long unexplored = g.edges() - g.degree(s);
+    bool bottom_up = false;
+    for (int level = 0; !frontier.empty(); level++)
+    {
+        long frontier_edges = 0;
+        for (size_t i = 0; i < frontier.size(); i++)
+        {
+            frontier_edges += g.degree(frontier[i]);
+        }
+        if (g.symmetric() && !bottom_up && frontier_edges > unexplored / 14)
+        {
+            bottom_up = true;
+            STAT_ADD(switches, 1);
+        }
+        else if (bottom_up && (long)frontier.size() < n / 24)
+        {
+            bottom_up = false;
+            STAT_ADD(switches, 1);
+        }
+        STAT_PHASE(phase, bottom_up ? "bfs level (bottom-up)" : "bfs level (top-down)");
+        STAT_ARGS(phase, level, (long)frontier.size());
+        STAT_ADD(levels, 1);
+        STAT_ADD(visited, (long)frontier.size());
+
+        next.clear();
+        if (bottom_up)
+        {
+            for (int v = 0; v < n; v++)
+            {
+                if (dist[v] >= 0)
+                {
+                    continue;
+                }
+                int parent = g.find_friend(v, [&](int u) {
+                    STAT_ADD(scanned, 1);
+                    return dist[u] == level;
+                });
+                if (parent >= 0)
+                {
+                    next.push_back(v);
+                }
+            }
+            for (size_t i = 0; i < next.size(); i++)
+            {
+                dist[next[i]] = level + 1;
+            }
+        }
+        else
+        {
+            STAT_ADD(scanned, frontier_edges);
+            for (size_t i = 0; i < frontier.size(); i++)
+            {
+                g.for_each_friend(frontier[i], [&](int u) {
+                    if (dist[u] < 0)
+                    {
+                        dist[u] = level + 1;
+                        next.push_back(u);
+                    }
+                });
+            }
+        }
+        for (size_t i = 0; i < next.size(); i++)
+        {
+            unexplored -= g.degree(next[i]);
+        }
+        frontier.swap(next);
+    }
+    return dist;
+}
+
+// Vertices on one shortest s -> t path, both ends included; empty if none.
+template <class G>
+vector<int> shortest_path(const G &g, int s, int t)
+{
+    STAT_PHASE(phase, "shortest path");
+    vector<int> parent(g.size(), -1);
+    vector<int> frontier(1, s);
+    parent[s] = s;
+    for (size_t head = 0; head < frontier.size() && parent[t] < 0; head++)
+    {
+        int v = frontier[head];
+        STAT_ADD(visited, 1);
+        STAT_ADD(scanned, g.degree(v));
+        g.for_each_friend(v, [&](int u) {
+            if (parent[u] < 0)
+            {
+                parent[u] = v;
+                frontier.push_back(u);
+            }
+        });
+    }
+    vector<int> path;
+    if (parent[t] < 0)
+    {
+        return path;
+    }
+    for (int v = t; v != s; v = parent[v])
+    {
+        path.push_back(v);
+    }
+    path.push_back(s);
+    reverse(path.begin(), path.end());
+    return path;
+}
+
+// Visit order of a breadth first traversal from s.
+template <class G>
+vector<int> bfs_order(const G &g, int s)
+{
+    STAT_PHASE(phase, "bfs");
+    vector<char> seen(g.size(), 0);
+    vector<int> order(1, s);
+    seen[s] = 1;
+    for (size_t head = 0; head < order.size(); head++)
+    {
+        STAT_ADD(visited, 1);
+        STAT_ADD(scanned, g.degree(order[head]));
+        g.for_each_friend(order[head], [&](int u) {
+            if (!seen[u])
+            {
+                seen[u] = 1;
+                order.push_back(u);
+            }
+        });
+    }
+    return order;
+}
+
+// Visit order of a depth first traversal from s, the same order dfs_r()
+// prints. Friends are stacked in reverse so the first one is expanded first;
+// a vertex may be stacked more than once but is only visited once.
+template <class G>
+vector<int> dfs_order(const G &g, int s)
+{
+    STAT_PHASE(phase, "dfs");
+    vector<char> seen(g.size(), 0);
+    vector<int> order, pending(1, s), friends;
+    while (!pending.empty())
+    {
+        int v = pending.back();
+        pending.pop_back();
+        if (seen[v])
+        {
+            continue;
+        }
+        seen[v] = 1;
+        order.push_back(v);
+        STAT_ADD(visited, 1);
+        STAT_ADD(scanned, g.degree(v));
+        friends.clear();
+        g.for_each_friend(v, [&](int u) {
+            if (!seen[u])
+            {
+                friends.push_back(u);
+            }
+        });
+        pending.insert(pending.end(), friends.rbegin(), friends.rend());
+    }
+    return order;
+}
+
+// Connected component of every vertex, numbered from 0 in order of each
+// component's smallest id. Directed graphs give weakly connected components;
+// symmetric ones union each friendship once instead of twice.
+template <class G>
+vector<int> components(const G &g)
+{
+    int n = g.size();
+    vector<int> parent(n);
+    iota(parent.begin(), parent.end(), 0);
+    for (int v = 0; v < n; v++)
+    {
+        auto unite = [&](int u) {
+            int a = v, b = u;
+            while (parent[a] != a)
+            {
+                a = parent[a] = parent[parent[a]];
+            }
+            while (parent[b] != b)
+            {
+                b = parent[b] = parent[parent[b]];
+            }
+            parent[max(a, b)] = min(a, b);
+        };
+        if (g.symmetric())
+        {
+            g.for_each_upper(v, unite);
+        }
+        else
+        {
+            g.for_each_friend(v, unite);
+        }
+    }
+    vector<int> label(n);
+    int count = 0;
+    for (int v = 0; v < n; v++)
+    {
+        label[v] = parent[v] == v ? count++ : label[parent[v]];
+    }
+    return label;
+}
+
+// Number of friend triangles in a symmetric graph. Each one is found once,
+// from its smallest member, by merging upper halves of sorted lists.
+template <class G>
+long count_triangles(const G &g)
+{
+    long count = 0;
+    vector<int> mine;
+    for (int v = 0; v < g.size(); v++)
+    {
+        mine.clear();
+        g.for_each_upper(v, [&](int u) {
+            mine.push_back(u);
+        });
+        for (size_t i = 0; i < mine.size(); i++)
+        {
+            size_t k = i + 1;
+            g.for_each_upper(mine[i], [&](int w) {
+                while (k < mine.size() && mine[k] < w)
+                {
+                    k++;
+                }
+                if (k < mine.size() && mine[k] == w)
+                {
+                    count++;
+                }
+            });
+        }
+    }
+    return count;
+}
+
+// Core numbers of a symmetric graph: core[v] is the largest k such that v
+// is in a subgraph where everyone has at least k friends. `order` is a
+// degeneracy ordering, people in the order they were peeled, so each one
+// has at most `degeneracy` friends later in it.
+struct cores
+{
+    vector<int> core;
+    vector<int> order;
+    int degeneracy;
+};
+
+// Batagelj-Zaversnik peeling in O(n + m): people sit in an array sorted
+// by current degree, with bin[d] where degree d starts. Taking the next
+// person in the array and moving each friend of larger degree down one
+// bin (a swap with that bin's first entry) keeps it sorted throughout.
+template <class G>
+cores core_numbers(const G &g)
+{
+    STAT_PHASE(phase, "core peeling");
+    int n = g.size(), top = 0;
+    vector<int> deg(n), bin, pos(n), vert(n);
+    for (int v = 0; v < n; v++)
+    {
+        deg[v] = g.degree(v);
+        top = max(top, deg[v]);
+    }
+    bin.assign(top + 1, 0);
+    for (int v = 0; v < n; v++)
+    {
+        bin[deg[v]]++;
+    }
+    for (int d = 0, start = 0; d <= top; d++)
+    {
+        int count = bin[d];
+        bin[d] = start;
+        start += count;
+    }
+    for (int v = 0; v < n; v++)
+    {
+        pos[v] = bin[deg[v]]++;
+        vert[pos[v]] = v;
+    }
+    for (int d = top; d > 0; d--)
+    {
+        bin[d] = bin[d - 1];
+    }
+    if (n > 0)
+    {
+        bin[0] = 0;
+    }
+    cores out;
+    out.degeneracy = 0;
+    for (int i = 0; i < n; i++)
+    {
+        int v = vert[i];
+        out.degeneracy = max(out.degeneracy, deg[v]);
+        STAT_ADD(visited, 1);
+        g.for_each_friend(v, [&](int u) {
+            STAT_ADD(scanned, 1);
+            if (deg[u] > deg[v])
+            {
+                int du = deg[u], pu = pos[u], pw = bin[du], w = vert[pw];
+                if (u != w)
+                {
+                    pos[u] = pw;
+                    vert[pu] = w;
+                    pos[w] = pu;
+                    vert[pw] = u;
+                }
+                bin[du]++;
+                deg[u]--;
+            }
+        });
+    }
+    out.core.swap(deg);
+    out.order.swap(vert);
+    return out;
+}
+
+// Level-synchronous peeling over `threads` workers. For each k, everyone
+// left with degree k is peeled in rounds: a round takes all of them at
+// once, each friend above k loses one (atomically) and those that drop to
+// k make up the next round. Levels nobody is at are skipped. Core numbers
+// match core_numbers(g); the order lists each round sorted by id.
+template <class G>
+cores core_numbers(const G &g, int threads)
+{
+    int n = g.size();
+    threads = max(threads, 1);
+    vector<atomic<int>> deg(n);
+    vector<char> done(n, 0);
+    for (int v = 0; v < n; v++)
+    {
+        deg[v].store(g.degree(v), memory_order_relaxed);
+    }
+    cores out;
+    out.core.assign(n, 0);
+    out.degeneracy = 0;
+    out.order.reserve(n);
+    vector<vector<int>> found(threads);
+    vector<int> least(threads);
+    vector<int> round;
+    for (int k = 0, left = n; left > 0; k++)
+    {
+        // Everyone still here at degree k, and the lowest degree left so
+        // empty levels can be skipped.
+        run_on_threads(threads, [&](int t) {
+            STAT_PHASE(phase, "core level scan");
+            least[t] = INT_MAX;
+            for (int v = (int)((long)n * t / threads); v < (int)((long)n * (t + 1) / threads); v++)
+            {
+                if (!done[v])
+                {
+                    least[t] = min(least[t], deg[v].load(memory_order_relaxed));
+                }
+            }
+        });
+        k = max(k, *min_element(least.begin(), least.end()));
+        run_on_threads(threads, [&](int t) {
+            found[t].clear();
+            for (int v = (int)((long)n * t / threads); v < (int)((long)n * (t + 1) / threads); v++)
+            {
+                if (!done[v] && deg[v].load(memory_order_relaxed) <= k)
+                {
+                    found[t].push_back(v);
+                }
+            }
+        });
+        round.clear();
+        for (int t = 0; t < threads; t++)
+        {
+            round.insert(round.end(), found[t].begin(), found[t].end());
+        }
+        while (!round.empty())
+        {
+            for (size_t i = 0; i < round.size(); i++)
+            {
+                done[round[i]] = 1;
+                out.core[round[i]] = k;
+            }
+            out.order.insert(out.order.end(), round.begin(), round.end());
+            left -= (int)round.size();
+            out.degeneracy = k;
+            atomic<size_t> cursor(0);
+            run_on_threads(threads, [&](int t) {
+                STAT_PHASE(phase, "core round");
+                found[t].clear();
+                for (size_t first; (first = cursor.fetch_add(256)) < round.size();)
+                {
+                    for (size_t i = first; i < min(first + 256, round.size()); i++)
+                    {
+                        STAT_ADD(visited, 1);
+                        g.for_each_friend(round[i], [&](int u) {
+                            STAT_ADD(scanned, 1);
+                            if (!done[u] && deg[u].load(memory_order_relaxed) > k && deg[u].fetch_sub(1, memory_order_relaxed) == k + 1)
+                            {
+                                found[t].push_back(u);
+                            }
+                        });
+                    }
+                }
+            });
+            round.clear();
+            for (int t = 0; t < threads; t++)
+            {
+                round.insert(round.end(), found[t].begin(), found[t].end());
+            }
+            sort(round.begin(), round.end());
+        }
+    }
+    return out;
+}
+
+// Monotone priority queue for integer keys. A key waits in the bucket of the
+// highest bit where it differs from the last key popped, so every key moves
+// to a lower bucket at most 64 times over its life.
+class radix_heap
+{
+    vector<pair<unsigned long, int>> bucket[65];
+    unsigned long last;
+    size_t count;
+
+    static int slot(unsigned long a, unsigned long b)
+    {
+        return a == b ? 0 : 64 - __builtin_clzl(a ^ b);
+    }
+
+public:
+    radix_heap() : last(0), count(0) {}
+    bool empty() const
+    {
+        return count == 0;
+    }
+    void push(unsigned long key, int v)
+    {
+        bucket[slot(key, last)].push_back(make_pair(key, v));
+        count++;
+    }
+    pair<unsigned long, int> pop()
+    {
+        if (bucket[0].empty())
+        {
+            int i = 1;
+            while (bucket[i].empty())
+            {
+                i++;
+            }
+            last = bucket[i][0].first;
+            for (size_t j = 1; j < bucket[i].size(); j++)
+            {
+                last = min(last, bucket[i][j].first);
+            }
+            for (size_t j = 0; j < bucket[i].size(); j++)
+            {
+                bucket[slot(bucket[i][j].first, last)].push_back(bucket[i][j]);
+            }
+            bucket[i].clear();
+        }
+        pair<unsigned long, int> top = bucket[0].back();
+        bucket[0].pop_back();
+        count--;
+        return top;
+    }
+};
+
+// Min-heap with four children per node: half the depth of a binary heap and
+// the children of a node share a cache line.
+template <class K>
+class quad_heap
+{
+    vector<pair<K, int>> h;
+
+public:
+    bool empty() const
+    {
+        return h.empty();
+    }
+    void push(K key, int v)
+    {
+        size_t i = h.size();
+        h.push_back(make_pair(key, v));
+        while (i > 0 && h[(i - 1) / 4].first > key)
+        {
+            h[i] = h[(i - 1) / 4];
+            i = (i - 1) / 4;
+        }
+        h[i] = make_pair(key, v);
+    }
+    pair<K, int> pop()
+    {
+        pair<K, int> top = h[0], moved = h.back();
+        h.pop_back();
+        size_t i = 0, n = h.size();
+        while (n > 0)
+        {
+            size_t best = 4 * i + 1;
+            if (best >= n)
+            {
+                break;
+            }
+            for (size_t c = best + 1; c < min(4 * i + 5, n); c++)
+            {
+                if (h[c].first < h[best].first)
+                {
+                    best = c;
+                }
+            }
+            if (!(h[best].first < moved.first))
+            {
+                break;
+            }
+            h[i] = h[best];
+            i = best;
+        }
+        if (n > 0)
+        {
+            h[i] = moved;
+        }
+        return top;
+    }
+};
+
+// Lazy Dijkstra over any heap with push(key, v)/pop(); stale entries are
+// skipped when popped. Stops once t (if given) is settled.
+template <class G, class Heap, class K>
+void dijkstra_with(const G &g, int s, int t, Heap &heap, vector<K> &dist, vector<int> &parent)
+{
+    STAT_PHASE(phase, "dijkstra");
+    const K unreached = numeric_limits<K>::max();
+    dist.assign(g.size(), unreached);
+    parent.assign(g.size(), -1);
+    dist[s] = 0;
+    parent[s] = s;
+    heap.push(0, s);
+    while (!heap.empty())
+    {
+        pair<K, int> top = heap.pop();
+        int v = top.second;
+        if (top.first != dist[v])
+        {
+            continue;
+        }
+        if (v == t)
+        {
+            return;
+        }
+        STAT_ADD(visited, 1);
+        STAT_ADD(scanned, g.degree(v));
+        g.for_each_edge(v, [&](int u, float w) {
+            K d = dist[v] + (K)w;
+            if (d < dist[u])
+            {
+                dist[u] = d;
+                parent[u] = v;
+                heap.push(d, u);
+            }
+        });
+    }
+}
+
+// Weighted distances from s (infinity where unreachable), optionally stopping
+// at t. Whole-number strengths run on a radix heap, others on a 4-ary heap.
+template <class G>
+vector<double> dijkstra(const G &g, int s, vector<int> &parent, int t = -1)
+{
+    vector<double> dist(g.size(), numeric_limits<double>::infinity());
+    if (g.whole())
+    {
+        radix_heap heap;
+        vector<unsigned long> exact;
+        dijkstra_with(g, s, t, heap, exact, parent);
+        for (int v = 0; v < g.size(); v++)
+        {
+            if (parent[v] >= 0)
+            {
+                dist[v] = (double)exact[v];
+            }
+        }
+    }
+    else
+    {
+        quad_heap<double> heap;
+        vector<double> exact;
+        dijkstra_with(g, s, t, heap, exact, parent);
+        for (int v = 0; v < g.size(); v++)
+        {
+            if (parent[v] >= 0)
+            {
+                dist[v] = exact[v];
+            }
+        }
+    }
+    return dist;
+}
+
+// Parallel delta-stepping: vertices are settled a bucket of width `width`
+// at a time. Light edges (<= width) are relaxed until the bucket stops
+// changing, heavy ones once per settled vertex. Each phase splits its
+// frontier across threads, and distances are lowered with compare-and-swap.
+// A width that isn't positive can't number buckets, so the mean strength
+// is used instead.
+template <class G>
+vector<double> delta_stepping(const G &g, int s, double width, int threads)
+{
+    int n = g.size();
+    const double inf = numeric_limits<double>::infinity();
+    threads = max(threads, 1);
+    if (!(width > 0))
+    {
+        double sum = 0;
+        long count = 0;
+        for (int v = 0; v < n; v++)
+        {
+            g.for_each_edge(v, [&](int, float w) {
+                sum += w;
+                count++;
+            });
+        }
+        width = count > 0 && sum > 0 ? sum / count : 1;
+    }
+    vector<atomic<double>> dist(n);
+    for (int v = 0; v < n; v++)
+    {
+        dist[v].store(inf);
+    }
+    dist[s].store(0);
+    vector<vector<int>> bucket(1, vector<int>(1, s));
+    vector<size_t> settled_in(n, 0);
+    vector<double> relaxed_at(n, inf);
+
+    // Relaxes light or heavy edges out of `from`, settled in bucket b, and
+    // files each improved end under its new bucket.
+    auto relax = [&](const vector<int> &from, bool light, size_t b) {
+        (void)b; // only traced
+        int parts = from.size() < 1024 ? 1 : threads;
+        vector<vector<int>> improved(parts);
+        auto run = [&](int p) {
+            STAT_PHASE(phase, light ? "delta-stepping light" : "delta-stepping heavy");
+            STAT_ARGS(phase, (long)b, (long)from.size());
+            for (size_t i = p; i < from.size(); i += parts)
+            {
+                int v = from[i];
+                double dv = dist[v].load();
+                STAT_ADD(visited, 1);
+                STAT_ADD(scanned, g.degree(v));
+                g.for_each_edge(v, [&](int u, float w) {
+                    if ((w <= width) != light)
+                    {
+                        return;
+                    }
+                    double d = dv + w, cur = dist[u].load();
+                    while (d < cur)
+                    {
+                        if (dist[u].compare_exchange_weak(cur, d))
+                        {
+                            improved[p].push_back(u);
+                            break;
+                        }
+                    }
+                });
+            }
+        };
+        run_on_threads(parts, run);
+        for (int p = 0; p < parts; p++)
+        {
+            for (size_t i = 0; i < improved[p].size(); i++)
+            {
+                int u = improved[p][i];
+                size_t to = (size_t)(dist[u].load() / width);
+                if (to >= bucket.size())
+                {
+                    bucket.resize(to + 1);
+                }
+                bucket[to].push_back(u);
+            }
+        }
+    };
+
+    for (size_t b = 0; b < bucket.size(); b++)
+    {
+        vector<int> settled;
+        while (!bucket[b].empty())
+        {
+            vector<int> frontier;
+            frontier.swap(bucket[b]);
+            size_t kept = 0;
+            for (size_t i = 0; i < frontier.size(); i++)
+            {
+                int v = frontier[i];
+                double dv = dist[v].load();
+                if ((size_t)(dv / width) != b || dv >= relaxed_at[v])
+                {
+                    continue;
+                }
+                relaxed_at[v] = dv;
+                frontier[kept++] = v;
+                if (settled_in[v] != b + 1)
+                {
+                    settled_in[v] = b + 1;
+                    settled.push_back(v);
+                }
+            }
+            frontier.resize(kept);
+            relax(frontier, true, b);
+        }
+        relax(settled, false, b);
+    }
+
+    vector<double> out(n);
+    for (int v = 0; v < n; v++)
+    {
+        out[v] = dist[v].load();
+    }
+    return out;
+}
+
+// Weighted distances from s: delta-stepping over `threads` workers when
+// there are several and the graph is big enough to repay them, Dijkstra
+// otherwise. `width` goes to delta_stepping (0 for the mean strength).
+template <class G>
+vector<double> shortest_distances(const G &g, int s, int threads, double width = 0)
+{
+    if (threads > 1 && g.edges() >= (1L << 16))
+    {
+        return delta_stepping(g, s, width, threads);
+    }
+    vector<int> parent(g.size(), -1);
+    return dijkstra(g, s, parent);
+}
+
+// Chase-Lev work-stealing deque of vertex ids. Its owner pushes and pops at
+// the bottom without contention; other threads steal from the top, and only
+// the last item is ever fought over with a CAS. A full ring is copied into
+// one twice the size; old rings stay alive until the deque dies because a
+// thief may still be reading one.
+class steal_deque
+{
+    struct ring
+    {
+        long mask;
+        vector<atomic<int>> slot;
+
+        ring(long size) : mask(size - 1), slot(size) {}
+        int get(long i) const
+        {
+            return slot[i & mask].load(memory_order_relaxed);
+        }
+        void put(long i, int v)
+        {
+            slot[i & mask].store(v, memory_order_relaxed);
+        }
+    };
+
+    atomic<long> top;
+    atomic<long> bottom;
+    atomic<ring *> buf;
+    vector<ring *> rings;
+
+public:
+    steal_deque() : top(0), bottom(0)
+    {
+        rings.push_back(new ring(256));
+        buf.store(rings.back());
+    }
+    ~steal_deque()
+    {
+        for (size_t i = 0; i < rings.size(); i++)
+        {
+            delete rings[i];
+        }
+    }
+    void push(int v)
+    {
+        long b = bottom.load(memory_order_relaxed);
+        long t = top.load(memory_order_acquire);
+        ring *a = buf.load(memory_order_relaxed);
+        if (b - t > a->mask)
+        {
+            ring *bigger = new ring(2 * (a->mask + 1));
+            for (long i = t; i < b; i++)
+            {
+                bigger->put(i, a->get(i));
+            }
+            rings.push_back(bigger);
+            buf.store(bigger, memory_order_release);
+            a = bigger;
+        }
+        a->put(b, v);
+        atomic_thread_fence(memory_order_release);
+        bottom.store(b + 1, memory_order_relaxed);
+    }
+    bool pop(int &v)
+    {
+        long b = bottom.load(memory_order_relaxed) - 1;
+        ring *a = buf.load(memory_order_relaxed);
+        bottom.store(b, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        long t = top.load(memory_order_relaxed);
+        if (t > b)
+        {
+            bottom.store(b + 1, memory_order_relaxed);
+            return false;
+        }
+        v = a->get(b);
+        if (t == b)
+        {
+            bool won = top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+            bottom.store(b + 1, memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+    bool steal(int &v)
+    {
+        long t = top.load(memory_order_acquire);
+        atomic_thread_fence(memory_order_seq_cst);
+        long b = bottom.load(memory_order_acquire);
+        if (t >= b)
+        {
+            return false;
+        }
+        ring *a = buf.load(memory_order_acquire);
+        v = a->get(t);
+        return top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+    }
+};
+
+// Everyone reachable from s, found by `threads` workers in no particular
+// order. A worker claims a person with one atomic exchange on their flag,
+// pushes them on its own deque and steals from the others when it runs dry,
+// so long thin chains keep every core busy where level-synchronous BFS
+// would have a handful of people per level. `pending` counts claimed people
+// not yet expanded; workers stop when it reaches zero.
+template <class G>
+vector<char> reachable(const G &g, int s, int threads)
+{
+    int n = g.size();
+    threads = max(threads, 1);
+    vector<atomic<char>> seen(n);
+    vector<steal_deque> work(threads);
+    atomic<long> pending(1);
+    seen[s].store(1);
+    work[0].push(s);
+
+    auto run = [&](int me) {
+        STAT_PHASE(phase, "reachability worker");
+        unsigned victim = me;
+        while (pending.load() > 0)
+        {
+            int v;
+            bool got = work[me].pop(v);
+            for (int tries = 0; !got && tries < threads; tries++)
+            {
+                victim = victim * 1103515245u + 12345u;
+                int from = (int)(victim % threads);
+                got = from != me && work[from].steal(v);
+            }
+            if (!got)
+            {
+                this_thread::yield();
+                continue;
+            }
+            STAT_ADD(visited, 1);
+            STAT_ADD(scanned, g.degree(v));
+            g.for_each_friend(v, [&](int u) {
+                if (seen[u].load(memory_order_relaxed) == 0 && seen[u].exchange(1) == 0)
+                {
+                    pending.fetch_add(1);
+                    work[me].push(u);
+                }
+            });
+            pending.fetch_sub(1);
+        }
+    };
+    run_on_threads(threads, run);
+
+    vector<char> out(n);
+    for (int v = 0; v < n; v++)
+    {
+        out[v] = seen[v].load();
+    }
+    return out;
+}
+
+// Plain CSR copy of a graph's friend lists, reversed if asked, for
+// algorithms that need to stop and resume partway along a list or to walk
+// friendships backwards. Reads like a directed graph, so kernels that only
+// follow friends run on it too.
+struct id_lists
+{
+    vector<int> at;
+    vector<int> to;
+
+    template <class G>
+    explicit id_lists(const G &g, bool reverse = false) : at(g.size() + 1, 0)
+    {
+        int n = g.size();
+        for (int v = 0; v < n; v++)
+        {
+            g.for_each_friend(v, [&](int u) {
+                at[(reverse ? u : v) + 1]++;
+            });
+        }
+        for (int v = 0; v < n; v++)
+        {
+            at[v + 1] += at[v];
+        }
+        to.resize(at[n]);
+        vector<int> fill(at.begin(), at.end() - 1);
+        for (int v = 0; v < n; v++)
+        {
+            g.for_each_friend(v, [&](int u) {
+                if (reverse)
+                {
+                    to[fill[u]++] = v;
+                }
+                else
+                {
+                    to[fill[v]++] = u;
+                }
+            });
+        }
+    }
+    int size() const
+    {
+        return (int)at.size() - 1;
+    }
+    long edges() const
+    {
+        return (long)to.size();
+    }
+    int degree(int v) const
+    {
+        return at[v + 1] - at[v];
+    }
+    bool symmetric() const
+    {
+        return false;
+    }
+    template <class F>
+    void for_each_friend(int v, F f) const
+    {
+        for (int e = at[v]; e < at[v + 1]; e++)
+        {
+            f(to[e]);
+        }
+    }
+};
+
+// Groups of people who can all reach each other along friendships, and the
+// DAG they form. Components are numbered in topological order, so every
+// friendship between two components runs from the lower number to the
+// higher; `dag_at`/`dag` list each component's successors once.
+struct strong_components
+{
+    vector<int> of;
+    vector<int> size;
+    vector<int> dag_at;
+    vector<int> dag;
+
+    int count() const
+    {
+        return (int)size.size();
+    }
+};
+
+// Tarjan's algorithm with an explicit call stack, so chains of millions of
+// people can't overflow the real one. Only people with of[v] < 0 take
+// part; their components are numbered from `next` in the order they close,
+// which is sinks first. Returns the next unused number.
+int tarjan(const id_lists &g, vector<int> &of, int next)
+{
+    STAT_PHASE(phase, "tarjan");
+    int n = g.size();
+    vector<int> index(n, -1), low(n), edge(n);
+    vector<int> open, calls;
+    int clock = 0;
+    for (int root = 0; root < n; root++)
+    {
+        if (of[root] >= 0 || index[root] >= 0)
+        {
+            continue;
+        }
+        auto enter = [&](int v) {
+            index[v] = low[v] = clock++;
+            edge[v] = g.at[v];
+            open.push_back(v);
+            calls.push_back(v);
+            STAT_ADD(visited, 1);
+        };
+        enter(root);
+        while (!calls.empty())
+        {
+            int v = calls.back();
+            if (edge[v] < g.at[v + 1])
+            {
+                int u = g.to[edge[v]++];
+                STAT_ADD(scanned, 1);
+                if (of[u] >= 0)
+                {
+                    continue;
+                }
+                if (index[u] < 0)
+                {
+                    enter(u);
+                }
+                else
+                {
+                    low[v] = min(low[v], index[u]);
+                }
+                continue;
+            }
+            calls.pop_back();
+            if (!calls.empty())
+            {
+                low[calls.back()] = min(low[calls.back()], low[v]);
+            }
+            if (low[v] == index[v])
+            {
+                int w;
+                do
+                {
+                    w = open.back();
+                    open.pop_back();
+                    of[w] = next;
+                } while (w != v);
+                next++;
+            }
+        }
+    }
+    return next;
+}
+
+// Renumbers `count` components topologically (Kahn's algorithm on the
+// condensation) and builds the condensation itself.
+strong_components condense(const id_lists &g, const vector<int> &of, int count)
+{
+    vector<pair<int, int>> arcs;
+    for (int v = 0; v < g.size(); v++)
+    {
+        g.for_each_friend(v, [&](int u) {
+            if (of[u] != of[v])
+            {
+                arcs.push_back(make_pair(of[v], of[u]));
+            }
+        });
+    }
+    sort(arcs.begin(), arcs.end());
+    arcs.erase(unique(arcs.begin(), arcs.end()), arcs.end());
+    vector<int> at(count + 1, 0), into(count, 0);
+    for (size_t i = 0; i < arcs.size(); i++)
+    {
+        at[arcs[i].first + 1]++;
+        into[arcs[i].second]++;
+    }
+    for (int c = 0; c < count; c++)
+    {
+        at[c + 1] += at[c];
+    }
+    vector<int> rank(count), ready;
+    for (int c = count - 1; c >= 0; c--)
+    {
+        if (into[c] == 0)
+        {
+            ready.push_back(c);
+        }
+    }
+    for (int placed = 0; !ready.empty(); placed++)
+    {
+        int c = ready.back();
+        ready.pop_back();
+        rank[c] = placed;
+        for (int e = at[c]; e < at[c + 1]; e++)
+        {
+            if (--into[arcs[e].second] == 0)
+            {
+                ready.push_back(arcs[e].second);
+            }
+        }
+    }
+
+    strong_components out;
+    out.of.resize(of.size());
+    out.size.assign(count, 0);
+    for (size_t v = 0; v < of.size(); v++)
+    {
+        out.of[v] = rank[of[v]];
+        out.size[out.of[v]]++;
+    }
+    for (size_t i = 0; i < arcs.size(); i++)
+    {
+        arcs[i] = make_pair(rank[arcs[i].first], rank[arcs[i].second]);
+    }
+    sort(arcs.begin(), arcs.end());
+    out.dag_at.assign(count + 1, 0);
+    for (size_t i = 0; i < arcs.size(); i++)
+    {
+        out.dag_at[arcs[i].first + 1]++;
+        out.dag.push_back(arcs[i].second);
+    }
+    for (int c = 0; c < count; c++)
+    {
+        out.dag_at[c + 1] += out.dag_at[c];
+    }
+    return out;
+}
+
+template <class G>
+strong_components strongly_connected(const G &g)
+{
+    id_lists lists(g);
+    vector<int> of(g.size(), -1);
+    int count = tarjan(lists, of, 0);
+    return condense(lists, of, count);
+}
+
+// Forward-backward: the people reachable both from and to a pivot are the
+// pivot's component, found by two parallel reachability sweeps. Picking
+// the pivot with the most friendships in times out lands it in the giant
+// component of a real network, so the sweeps take the bulk of the graph
+// and iterative Tarjan only mops up the small components left over.
+template <class G>
+strong_components strongly_connected(const G &g, int threads)
+{
+    int n = g.size();
+    id_lists forward(g), backward(g, true);
+    vector<int> of(n, -1);
+    int count = 0;
+    if (n > 0)
+    {
+        int pivot = 0;
+        for (int v = 1; v < n; v++)
+        {
+            if ((long)forward.degree(v) * backward.degree(v) > (long)forward.degree(pivot) * backward.degree(pivot))
+            {
+                pivot = v;
+            }
+        }
+        vector<char> ahead = reachable(forward, pivot, threads);
+        vector<char> behind = reachable(backward, pivot, threads);
+        for (int v = 0; v < n; v++)
+        {
+            if (ahead[v] && behind[v])
+            {
+                of[v] = 0;
+            }
+        }
+        count = 1;
+    }
+    count = tarjan(forward, of, count);
+    return condense(forward, of, count);
+}
+
+// Dense score table over person ids that is cheap to reuse: add() records
+// each id the first time it's touched, and clear() resets only those.
+class accumulator
+{
+    vector<double> score;
+    vector<int> touched;
+
+public:
+    void reset(int n)
+    {
+        clear();
+        score.assign(n, 0);
+    }
+    void add(int v, double x)
+    {
+        if (score[v] == 0)
+        {
+            touched.push_back(v);
+        }
+        score[v] += x;
+    }
+    double get(int v) const
+    {
+        return score[v];
+    }
+    const vector<int> &keys() const
+    {
+        return touched;
+    }
+    void clear()
+    {
+        for (size_t i = 0; i < touched.size(); i++)
+        {
+            score[touched[i]] = 0;
+        }
+        touched.clear();
+    }
+};
+
+// "People you may know" for v: friends of friends who aren't already
+// friends, scored by the number of friends in common or by Adamic-Adar
+// (each common friend z adds 1 / log deg(z), so well-connected go-betweens
+// count for less). Returns the best k as (score, person), highest first.
+// `acc` must have been reset to g.size() and is left cleared.
+template <class G>
+vector<pair<double, int>> recommend(const G &g, int v, int k, bool adamic_adar, accumulator &acc)
+{
+    const double friend_already = -1e300;
+    g.for_each_friend(v, [&](int z) {
+        acc.add(z, friend_already);
+    });
+    g.for_each_friend(v, [&](int z) {
+        double w = adamic_adar ? 1 / log((double)max(g.degree(z), 2)) : 1;
+        g.for_each_friend(z, [&](int u) {
+            if (u != v)
+            {
+                acc.add(u, w);
+            }
+        });
+    });
+
+    vector<pair<double, int>> best;
+    for (size_t i = 0; i < acc.keys().size(); i++)
+    {
+        int u = acc.keys()[i];
+        if (acc.get(u) > 0)
+        {
+            best.push_back(make_pair(acc.get(u), u));
+        }
+    }
+    acc.clear();
+    auto better = [](const pair<double, int> &a, const pair<double, int> &b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    };
+    size_t keep = min(best.size(), (size_t)max(k, 0));
+    partial_sort(best.begin(), best.begin() + keep, best.end(), better);
+    best.resize(keep);
+    return best;
+}
+
+// recommend() for everyone, spread over `threads` workers that each own an
+// accumulator and take people in chunks from a shared counter.
+template <class G>
+vector<vector<pair<double, int>>> recommend_all(const G &g, int k, bool adamic_adar, int threads)
+{
+    int n = g.size();
+    vector<vector<pair<double, int>>> out(n);
+    atomic<int> next(0);
+    auto run = [&](int) {
+        STAT_PHASE(phase, "recommendations");
+        accumulator acc;
+        acc.reset(n);
+        for (int start; (start = next.fetch_add(64)) < n;)
+        {
+            for (int v = start; v < min(start + 64, n); v++)
+            {
+                out[v] = recommend(g, v, k, adamic_adar, acc);
+            }
+        }
+    };
+    run_on_threads(threads, run);
+    return out;
+}
+
+// Betweenness centrality by Brandes' algorithm. One BFS per source counts
+// shortest paths (sigma); walking that BFS order backwards accumulates each
+// person's dependency on the source. Sources are handed out to `threads`
+// workers, each with its own sigma/dist/dependency arrays and partial sums,
+// merged at the end. With pivots > 0 only that many sources, drawn with
+// `seed`, are used and the sums scaled by n / pivots. On symmetric graphs
+// every pair is seen from both ends, so scores are halved.
+template <class G>
+vector<double> betweenness(const G &g, int threads, int pivots = 0, unsigned seed = 1)
+{
+    int n = g.size();
+    vector<int> sources(n);
+    iota(sources.begin(), sources.end(), 0);
+    if (pivots > 0 && pivots < n)
+    {
+        mt19937 rng(seed);
+        shuffle(sources.begin(), sources.end(), rng);
+        sources.resize(pivots);
+    }
+    double scale = (double)n / sources.size() * (g.symmetric() ? 0.5 : 1);
+
+    threads = max(threads, 1);
+    vector<vector<double>> partial(threads);
+    atomic<size_t> next(0);
+    auto run = [&](int me) {
+        STAT_PHASE(phase, "betweenness");
+        vector<double> &sum = partial[me];
+        sum.assign(n, 0);
+        vector<double> sigma(n, 0), dep(n, 0);
+        vector<int> dist(n, -1), order;
+        for (size_t i; (i = next.fetch_add(1)) < sources.size();)
+        {
+            int s = sources[i];
+            order.assign(1, s);
+            dist[s] = 0;
+            sigma[s] = 1;
+            for (size_t head = 0; head < order.size(); head++)
+            {
+                int v = order[head];
+                STAT_ADD(visited, 1);
+                STAT_ADD(scanned, g.degree(v));
+                g.for_each_friend(v, [&](int w) {
+                    if (dist[w] < 0)
+                    {
+                        dist[w] = dist[v] + 1;
+                        order.push_back(w);
+                    }
+                    if (dist[w] == dist[v] + 1)
+                    {
+                        sigma[w] += sigma[v];
+                    }
+                });
+            }
+            for (size_t k = order.size(); k-- > 0;)
+            {
+                int v = order[k];
+                g.for_each_friend(v, [&](int w) {
+                    if (dist[w] == dist[v] + 1)
+                    {
+                        dep[v] += sigma[v] / sigma[w] * (1 + dep[w]);
+                    }
+                });
+                if (v != s)
+                {
+                    sum[v] += dep[v];
+                }
+            }
+            for (size_t k = 0; k < order.size(); k++)
+            {
+                int v = order[k];
+                dist[v] = -1;
+                sigma[v] = 0;
+                dep[v] = 0;
+            }
+        }
+    };
+    run_on_threads(threads, run);
+
+    vector<double> score(n, 0);
+    for (int t = 0; t < threads; t++)
+    {
+        for (int v = 0; v < n; v++)
+        {
+            score[v] += partial[t][v];
+        }
+    }
+    for (int v = 0; v < n; v++)
+    {
+        score[v] *= scale;
+    }
+    return score;
+}
+
+// Result of community detection: the community of every person, numbered
+// from 0 by decreasing size, and how many people each one holds.
+struct communities
+{
+    vector<int> of;
+    vector<int> size;
+    int rounds;
+};
+
+// Asynchronous label propagation. Everyone starts in their own community and
+// repeatedly adopts the label most common among their friends (keeping
+// their own on a tie, otherwise breaking ties by a seeded hash). Updates are
+// visible to other workers at once. Only people whose friends changed label
+// are revisited in the next round, processed in chunks taken from a shared
+// counter in a seeded order. With one thread the result depends only on the
+// seed; with more, on which worker reads a label first, so it can change
+// from run to run.
+template <class G>
+communities propagate_labels(const G &g, unsigned seed, int threads, int max_rounds = 100)
+{
+    int n = g.size();
+    threads = max(threads, 1);
+    vector<atomic<int>> label(n);
+    vector<atomic<char>> queued(n);
+    vector<int> frontier(n);
+    for (int v = 0; v < n; v++)
+    {
+        label[v].store(v);
+        queued[v].store(1);
+        frontier[v] = v;
+    }
+    mt19937 rng(seed);
+    shuffle(frontier.begin(), frontier.end(), rng);
+    auto tie = [seed](int l) {
+        unsigned long x = (unsigned long)l * 0x9e3779b97f4a7c15ul ^ seed;
+        return x ^ (x >> 31);
+    };
+
+    communities out;
+    for (out.rounds = 0; out.rounds < max_rounds && !frontier.empty(); out.rounds++)
+    {
+        vector<vector<int>> next(threads);
+        atomic<size_t> cursor(0);
+        auto run = [&](int me) {
+            STAT_PHASE(phase, "label propagation round");
+            accumulator votes;
+            votes.reset(n);
+            for (size_t start; (start = cursor.fetch_add(256)) < frontier.size();)
+            {
+                for (size_t i = start; i < min(start + 256, frontier.size()); i++)
+                {
+                    int v = frontier[i];
+                    queued[v].store(0);
+                    STAT_ADD(visited, 1);
+                    STAT_ADD(scanned, g.degree(v));
+                    g.for_each_friend(v, [&](int u) {
+                        votes.add(label[u].load(memory_order_relaxed), 1);
+                    });
+                    int mine = label[v].load(memory_order_relaxed), best = mine;
+                    double most = votes.keys().empty() ? 0 : votes.get(mine);
+                    for (size_t k = 0; k < votes.keys().size(); k++)
+                    {
+                        int l = votes.keys()[k];
+                        double c = votes.get(l);
+                        if (c > most || (c == most && best != mine && tie(l) < tie(best)))
+                        {
+                            most = c;
+                            best = l;
+                        }
+                    }
+                    votes.clear();
+                    if (best == mine)
+                    {
+                        continue;
+                    }
+                    label[v].store(best, memory_order_relaxed);
+                    g.for_each_friend(v, [&](int u) {
+                        if (queued[u].exchange(1) == 0)
+                        {
+                            next[me].push_back(u);
+                        }
+                    });
+                }
+            }
+        };
+        run_on_threads(threads, run);
+        frontier.clear();
+        for (int t = 0; t < threads; t++)
+        {
+            frontier.insert(frontier.end(), next[t].begin(), next[t].end());
+        }
+        sort(frontier.begin(), frontier.end());
+        shuffle(frontier.begin(), frontier.end(), rng);
+    }
+
+    vector<int> count(n, 0);
+    for (int v = 0; v < n; v++)
+    {
+        count[label[v].load()]++;
+    }
+    vector<int> by_size;
+    for (int l = 0; l < n; l++)
+    {
+        if (count[l] > 0)
+        {
+            by_size.push_back(l);
+        }
+    }
+    stable_sort(by_size.begin(), by_size.end(), [&](int a, int b) {
+        return count[a] > count[b];
+    });
+    vector<int> renamed(n, -1);
+    for (size_t c = 0; c < by_size.size(); c++)
+    {
+        renamed[by_size[c]] = (int)c;
+        out.size.push_back(count[by_size[c]]);
+    }
+    out.of.resize(n);
+    for (int v = 0; v < n; v++)
+    {
+        out.of[v] = renamed[label[v].load()];
+    }
+    return out;
+}
+
+void distance_index::flatten(labels &from, vector<long> &at, vector<int> &hub, vector<unsigned short> &dist)
+{
+    at.assign(from.size() + 1, 0);
+    hub.clear();
+    dist.clear();
+    for (size_t v = 0; v < from.size(); v++)
+    {
+        for (size_t i = 0; i < from[v].size(); i++)
+        {
+            hub.push_back(from[v][i].first);
+            dist.push_back(from[v][i].second);
+        }
+        at[v + 1] = (long)hub.size();
+        vector<pair<int, unsigned short>>().swap(from[v]);
+    }
+}
+
+int distance_index::meet(const int *ah, const unsigned short *ad, long an, const int *bh, const unsigned short *bd, long bn)
+{
+    int best = INT_MAX;
+    long i = 0, j = 0;
+    while (i < an && j < bn)
+    {
+        if (ah[i] == bh[j])
+        {
+            best = min(best, ad[i++] + bd[j++]);
+        }
+        else if (ah[i] < bh[j])
+        {
+            i++;
+        }
+        else
+        {
+            j++;
+        }
+    }
+    return best == INT_MAX ? -1 : best;
+}
+
+// File layout: "PLL1", fingerprint, people, symmetric flag, then the out-
+// and in-label arrays, each as a length followed by its raw elements.
+bool distance_index::save(const string &path) const
+{
+    ofstream out(path.c_str(), ios::binary);
+    out.write("PLL1", 4);
+    out.write((const char *)&print, sizeof(print));
+    out.write((const char *)&n, sizeof(n));
+    out.write((const char *)&mutual, sizeof(mutual));
+    auto put = [&](const auto &v) {
+        size_t count = v.size();
+        out.write((const char *)&count, sizeof(count));
+        out.write((const char *)v.data(), count * sizeof(v[0]));
+    };
+    put(out_at);
+    put(out_hub);
+    put(out_dist);
+    put(in_at);
+    put(in_hub);
+    put(in_dist);
+    return (bool)out;
+}
+
+// Reads an index saved by save(); fails unless it was built from a graph
+// with fingerprint `expected` and every array is the size the others say it
+// is, so a truncated or corrupt file can't make queries read past a label.
+// A failed load leaves the index as it was. On success it answers for
+// version `ver`.
+bool distance_index::load(const string &path, unsigned long expected, long ver)
+{
+    ifstream in(path.c_str(), ios::binary | ios::ate);
+    long left = (long)in.tellg();
+    in.seekg(0);
+    char magic[4], sym = 0;
+    unsigned long saved;
+    int people = -1;
+    if (!in.read(magic, 4) || memcmp(magic, "PLL1", 4) != 0 || !in.read((char *)&saved, sizeof(saved)) || saved != expected)
+    {
+        return false;
+    }
+    in.read((char *)&people, sizeof(people));
+    in.read((char *)&sym, sizeof(sym));
+    left -= 4 + (long)sizeof(saved) + (long)sizeof(people) + (long)sizeof(sym);
+    if (!in || people < 0 || (sym != 0 && sym != 1))
+    {
+        return false;
+    }
+    auto get = [&](auto &v) {
+        size_t count = 0;
+        if (!in.read((char *)&count, sizeof(count)) || (left -= (long)sizeof(count)) < 0 || count > (size_t)left / sizeof(v[0]))
+        {
+            return false;
+        }
+        v.resize(count);
+        left -= (long)(count * sizeof(v[0]));
+        return (bool)in.read((char *)v.data(), count * sizeof(v[0]));
+    };
+    // Offsets start at 0, never fall, and end at the label arrays' length;
+    // each label lists hubs below `people` in increasing order, as meet()
+    // expects.
+    auto sound = [&](const vector<long> &at, const vector<int> &hub, const vector<unsigned short> &dist, size_t lists) {
+        if (at.size() != lists + 1 || at[0] != 0 || at[lists] != (long)hub.size() || dist.size() != hub.size())
+        {
+            return false;
+        }
+        for (size_t v = 0; v < lists; v++)
+        {
+            if (at[v + 1] < at[v])
+            {
+                return false;
+            }
+            for (long i = at[v]; i < at[v + 1]; i++)
+            {
+                if (hub[i] < 0 || hub[i] >= people || (i > at[v] && hub[i] <= hub[i - 1]))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+    vector<long> oa, ia;
+    vector<int> oh, ih;
+    vector<unsigned short> od, id;
+    if (!get(oa) || !get(oh) || !get(od) || !get(ia) || !get(ih) || !get(id) || left != 0)
+    {
+        return false;
+    }
+    if (!sound(oa, oh, od, people) || !sound(ia, ih, id, sym ? 0 : people))
+    {
+        return false;
+    }
+    n = people;
+    mutual = sym;
+    out_at.swap(oa);
+    out_hub.swap(oh);
+    out_dist.swap(od);
+    in_at.swap(ia);
+    in_hub.swap(ih);
+    in_dist.swap(id);
+    print = saved;
+    version = ver;
+    return true;
+}
+
+// SplitMix64's finaliser: a cheap bijection that scatters nearby inputs.
+unsigned long mix64(unsigned long h)
+{
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ul;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebul;
+    return h ^ (h >> 31);
+}
+
+// Register-wise max of two HyperLogLog counters of m registers, 16 at a
+// time with SSE2 where it's available. Returns true if `into` changed.
+bool merge_registers(unsigned char *into, const unsigned char *from, int m)
+{
+    bool changed = false;
+    int i = 0;
+#ifdef __SSE2__
+    __m128i grew = _mm_setzero_si128();
+    for (; i + 16 <= m; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(into + i));
+        __m128i c = _mm_max_epu8(a, _mm_loadu_si128((const __m128i *)(from + i)));
+        grew = _mm_or_si128(grew, _mm_xor_si128(a, c));
+        _mm_storeu_si128((__m128i *)(into + i), c);
+    }
+    changed = _mm_movemask_epi8(_mm_cmpeq_epi8(grew, _mm_setzero_si128())) != 0xFFFF;
+#endif
+    for (; i < m; i++)
+    {
+        if (from[i] > into[i])
+        {
+            into[i] = from[i];
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// HyperLogLog cardinality of m registers, with linear counting for small
+// counts where the raw estimate is biased.
+double count_registers(const unsigned char *r, int m)
+{
+    double sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < m; i++)
+    {
+        sum += ldexp(1.0, -r[i]);
+        zeros += r[i] == 0;
+    }
+    double alpha = m == 16 ? 0.673 : m == 32 ? 0.697 : m == 64 ? 0.709 : 0.7213 / (1 + 1.079 / m);
+    double e = alpha * m * m / sum;
+    return e <= 2.5 * m && zeros > 0 ? m * log((double)m / zeros) : e;
+}
+
+// Approximate neighbourhood function. `pairs[t]` estimates how many
+// (person, someone within t hops of them) pairs there are, `reach[v]` how
+// many people v reaches within the requested number of hops (v included),
+// and `effective_diameter` the hops within which 90% of all reachable
+// pairs lie, interpolated between whole hops.
+struct neighbourhood
+{
+    vector<double> pairs;
+    vector<float> reach;
+    double effective_diameter;
+};
+
+// HyperANF: every person keeps a HyperLogLog counter of the people within
+// t hops of them, and round t+1 unions in the counters of their friends
+// from round t. Each round is one linear pass over the lists with 2^bits
+// bytes of registers per person (standard error about 1.04 / 2^(bits/2));
+// rounds stop when no counter changes, which takes the diameter plus one.
+template <class G>
+neighbourhood hyper_anf(const G &g, int hops, int threads, int bits = 7, unsigned long seed = 1, int max_rounds = 64)
+{
+    int n = g.size(), m = 1 << bits;
+    threads = max(threads, 1);
+    vector<unsigned char> now((size_t)n * m, 0), next;
+    vector<float> estimate(n);
+    for (int v = 0; v < n; v++)
+    {
+        unsigned long h = mix64(((unsigned long)v + seed) * 0x9e3779b97f4a7c15ul);
+        unsigned long rest = h << bits;
+        now[(size_t)v * m + (h >> (64 - bits))] = (unsigned char)(rest == 0 ? 64 - bits + 1 : __builtin_clzl(rest) + 1);
+        estimate[v] = (float)count_registers(&now[(size_t)v * m], m);
+    }
+
+    neighbourhood out;
+    out.pairs.push_back(accumulate(estimate.begin(), estimate.end(), 0.0));
+    out.reach = estimate;
+    for (int t = 1; t <= max_rounds; t++)
+    {
+        next = now;
+        atomic<bool> changed(false);
+        atomic<int> cursor(0);
+        auto run = [&](int) {
+            STAT_PHASE(phase, "hyperanf round");
+            bool mine = false;
+            for (int start; (start = cursor.fetch_add(256)) < n;)
+            {
+                for (int v = start; v < min(start + 256, n); v++)
+                {
+                    unsigned char *row = &next[(size_t)v * m];
+                    bool grew = false;
+                    STAT_ADD(visited, 1);
+                    STAT_ADD(scanned, g.degree(v));
+                    g.for_each_friend(v, [&](int u) {
+                        grew = merge_registers(row, &now[(size_t)u * m], m) || grew;
+                    });
+                    if (grew)
+                    {
+                        estimate[v] = (float)count_registers(row, m);
+                        mine = true;
+                    }
+                }
+            }
+            if (mine)
+            {
+                changed.store(true);
+            }
+        };
+        run_on_threads(threads, run);
+        if (!changed.load())
+        {
+            break;
+        }
+        now.swap(next);
+        out.pairs.push_back(accumulate(estimate.begin(), estimate.end(), 0.0));
+        if (t <= hops)
+        {
+            out.reach = estimate;
+        }
+    }
+
+    double goal = 0.9 * out.pairs.back();
+    size_t t = 0;
+    while (out.pairs[t] < goal)
+    {
+        t++;
+    }
+    out.effective_diameter = t == 0 ? 0 : t - 1 + (goal - out.pairs[t - 1]) / (out.pairs[t] - out.pairs[t - 1]);
+    return out;
+}
+
+// Buffered writer for exports: text collects in one 64 KiB buffer that
+// goes out in a single write() whenever it fills, so an export holds at
+// most that much of the document at a time.
+class buffered_sink
+{
+    int fd;
+    bool owned;
+    bool failed;
+    vector<char> buffer;
+    size_t used;
+
+public:
+    explicit buffered_sink(int to) : fd(to), owned(false), failed(to < 0), buffer(1 << 16), used(0) {}
+    explicit buffered_sink(const string &path) : fd(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)), owned(true), failed(fd < 0), buffer(1 << 16), used(0) {}
+    ~buffered_sink()
+    {
+        flush();
+        if (owned && fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    bool ok() const
+    {
+        return !failed;
+    }
+    bool flush()
+    {
+        for (size_t done = 0; done < used && !failed;)
+        {
+            ssize_t k = write(fd, &buffer[done], used - done);
+            if (k < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            failed = k <= 0;
+            done += k > 0 ? k : 0;
+        }
+        used = 0;
+        return !failed;
+    }
+    buffered_sink &operator<<(string_view s)
+    {
+        while (!s.empty())
+        {
+            if (used == buffer.size())
+            {
+                flush();
+            }
+            size_t k = min(s.size(), buffer.size() - used);
+            memcpy(&buffer[used], s.data(), k);
+            used += k;
+            s.remove_prefix(k);
+        }
+        return *this;
+    }
+    buffered_sink &operator<<(char c)
+    {
+        if (used == buffer.size())
+        {
+            flush();
+        }
+        buffer[used++] = c;
+        return *this;
+    }
+    buffered_sink &operator<<(long x)
+    {
+        char digits[24];
+        return *this << string_view(digits, to_chars(digits, digits + sizeof(digits), x).ptr - digits);
+    }
+    buffered_sink &operator<<(int x)
+    {
+        return *this << (long)x;
+    }
+    buffered_sink &operator<<(float x)
+    {
+        char digits[32];
+        return *this << string_view(digits, snprintf(digits, sizeof(digits), "%g", x));
+    }
+};
+
+// Everyone within `radius` hops of v, for exporting v's ego network.
+template <class G>
+vector<char> ego_mask(const G &g, int v, int radius)
+{
+    vector<int> d = hops(g, v);
+    vector<char> keep(d.size());
+    for (size_t u = 0; u < d.size(); u++)
+    {
+        keep[u] = d[u] >= 0 && d[u] <= radius;
+    }
+    return keep;
+}
+
+// Everyone in v's group (see components()), for exporting just that group.
+template <class G>
+vector<char> group_mask(const G &g, int v)
+{
+    vector<int> label = components(g);
+    vector<char> keep(label.size());
+    for (size_t u = 0; u < label.size(); u++)
+    {
+        keep[u] = label[u] == label[v];
+    }
+    return keep;
+}
+
+// Streams g as GraphViz DOT, one statement per line. People are nodes
+// n<id> labelled with their names; a symmetric graph writes each
+// friendship once. With a non-empty `keep`, only marked people and the
+// friendships between them are written.
+template <class G>
+void export_dot(const G &g, buffered_sink &out, const vector<char> &keep)
+{
+    STAT_PHASE(phase, "export dot");
+    vector<char> shown(g.size());
+    for (int v = 0; v < g.size(); v++)
+    {
+        shown[v] = (keep.empty() || keep[v]) && g.present(v);
+    }
+    auto in = [&](int v) {
+        return shown[v] != 0;
+    };
+    auto quoted = [&](const string &s) {
+        out << '"';
+        if (s.find_first_of("\"\\") == string::npos)
+        {
+            out << string_view(s) << '"';
+            return;
+        }
+        for (size_t i = 0; i < s.size(); i++)
+        {
+            if (s[i] == '"' || s[i] == '\\')
+            {
+                out << '\\';
+            }
+            out << s[i];
+        }
+        out << '"';
+    };
+    out << (g.symmetric() ? "graph" : "digraph") << " friends {\n";
+    for (int v = 0; v < g.size(); v++)
+    {
+        if (in(v))
+        {
+            out << "  n" << v << " [label=";
+            quoted(g.name(v));
+            out << "];\n";
+        }
+    }
+    for (int v = 0; v < g.size(); v++)
+    {
+        if (!in(v))
+        {
+            continue;
+        }
+        g.for_each_edge(v, [&](int u, float w) {
+            if (!in(u) || (g.symmetric() && u < v))
+            {
+                return;
+            }
+            out << "  n" << v << (g.symmetric() ? " -- n" : " -> n") << u;
+            if (g.weighted())
+            {
+                out << " [weight=" << w << "]";
+            }
+            out << ";\n";
+        });
+    }
+    out << "}\n";
+}
+
+// Streams g as GraphML, with the same node ids, filter and one-edge-per-
+// friendship rule as export_dot(). Names and strengths are data keys.
+template <class G>
+void export_graphml(const G &g, buffered_sink &out, const vector<char> &keep)
+{
+    STAT_PHASE(phase, "export graphml");
+    vector<char> shown(g.size());
+    for (int v = 0; v < g.size(); v++)
+    {
+        shown[v] = (keep.empty() || keep[v]) && g.present(v);
+    }
+    auto in = [&](int v) {
+        return shown[v] != 0;
+    };
+    auto escaped = [&](const string &s) {
+        if (s.find_first_of("&<>\"") == string::npos)
+        {
+            out << string_view(s);
+            return;
+        }
+        for (size_t i = 0; i < s.size(); i++)
+        {
+            switch (s[i])
+            {
+            case '&':
+                out << "&amp;";
+                break;
+            case '<':
+                out << "&lt;";
+                break;
+            case '>':
+                out << "&gt;";
+                break;
+            case '"':
+                out << "&quot;";
+                break;
+            default:
+                out << s[i];
+            }
+        }
+    };
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        << "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+        << "  <key id=\"name\" for=\"node\" attr.name=\"name\" attr.type=\"string\"/>\n";
+    if (g.weighted())
+    {
+        out << "  <key id=\"weight\" for=\"edge\" attr.name=\"weight\" attr.type=\"float\"/>\n";
+    }
+    out << "  <graph id=\"friends\" edgedefault=\"" << (g.symmetric() ? "undirected" : "directed") << "\">\n";
+    for (int v = 0; v < g.size(); v++)
+    {
+        if (in(v))
+        {
+            out << "    <node id=\"n" << v << "\"><data key=\"name\">";
+            escaped(g.name(v));
+            out << "</data></node>\n";
+        }
+    }
+    for (int v = 0; v < g.size(); v++)
+    {
+        if (!in(v))
+        {
+            continue;
+        }
+        g.for_each_edge(v, [&](int u, float w) {
+            if (!in(u) || (g.symmetric() && u < v))
+            {
+                return;
+            }
+            out << "    <edge source=\"n" << v << "\" target=\"n" << u << "\"";
+            if (g.weighted())
+            {
+                out << "><data key=\"weight\">" << w << "</data></edge>\n";
+            }
+            else
+            {
+                out << "/>\n";
+            }
+        });
+    }
+    out << "  </graph>\n</graphml>\n";
+}
+
+// Counter-based random numbers: draw k of stream s is a hash of (seed, s,
+// k), so a walk comes out the same whichever thread generates it and no
+// generator state is shared.
+struct counter_rng
+{
+    unsigned long key;
+    unsigned long count;
+
+    counter_rng(unsigned long seed, unsigned long stream) : key(mix64(mix64(seed) ^ (stream * 0x9e3779b97f4a7c15ul))), count(0) {}
+    unsigned long next()
+    {
+        return mix64(key + ++count * 0x9e3779b97f4a7c15ul);
+    }
+    // Uniform in [0, n), by multiply-shift rather than a division.
+    unsigned below(unsigned n)
+    {
+        return (unsigned)(((next() >> 32) * n) >> 32);
+    }
+    double unit()
+    {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+// Walks, all the same length, one after another in a flat array of 32-bit
+// ids. A walk that stops early (no friends to go on to) is padded with
+// `none`. save() writes "WALK1", the walk count and length as 8-byte
+// integers, then the ids as they are.
+struct walk_buffer
+{
+    static const uint32_t none = 0xFFFFFFFFu;
+    long count;
+    int length;
+    vector<uint32_t> ids;
+
+    const uint32_t *walk(long w) const
+    {
+        return &ids[(size_t)w * length];
+    }
+    bool save(const string &path) const
+    {
+        buffered_sink out(path);
+        long header[2] = {count, (long)length};
+        out << string_view("WALK1", 5) << string_view((const char *)header, sizeof(header));
+        out << string_view((const char *)ids.data(), ids.size() * sizeof(uint32_t));
+        return out.flush();
+    }
+};
+
+// Random-walk generator for embedding training. It copies the friend
+// lists into a sorted CSR and, for weighted walks, builds an alias table
+// per person (Vose's method) so each step picks a friend in O(1) whatever
+// the strengths. node2vec's second-order bias is applied by rejection:
+// propose the next friend from the first-order distribution and keep it
+// with probability bias / max bias, where bias is 1/p for stepping back,
+// 1 for a friend of the previous person and 1/q otherwise; "friend of the
+// previous person" is a binary search in their sorted list. With p = q = 1
+// every proposal is kept.
+class walker
+{
+    vector<int> at;
+    vector<int> to;
+    vector<float> prob;
+    vector<int> alias;
+
+    bool adjacent(int t, int x) const
+    {
+        return binary_search(to.begin() + at[t], to.begin() + at[t + 1], x);
+    }
+    int step(int v, counter_rng &rng) const
+    {
+        int d = at[v + 1] - at[v];
+        int i = (int)rng.below((unsigned)d);
+        if (!prob.empty() && rng.unit() >= prob[at[v] + i])
+        {
+            i = alias[at[v] + i];
+        }
+        return to[at[v] + i];
+    }
+
+public:
+    template <class G>
+    walker(const G &g, bool weighted, int threads) : at(g.size() + 1, 0)
+    {
+        int n = g.size();
+        vector<float> weight;
+        vector<pair<int, float> > list;
+        for (int v = 0; v < n; v++)
+        {
+            list.clear();
+            g.for_each_edge(v, [&](int u, float w) {
+                list.push_back(make_pair(u, w));
+            });
+            sort(list.begin(), list.end());
+            for (size_t i = 0; i < list.size(); i++)
+            {
+                to.push_back(list[i].first);
+                if (weighted)
+                {
+                    weight.push_back(list[i].second);
+                }
+            }
+            at[v + 1] = (int)to.size();
+        }
+        if (!weighted)
+        {
+            return;
+        }
+        prob.resize(to.size());
+        alias.resize(to.size());
+        threads = max(threads, 1);
+        atomic<int> cursor(0);
+        auto run = [&](int) {
+            STAT_PHASE(phase, "alias tables");
+            vector<int> small, large;
+            for (int first; (first = cursor.fetch_add(1024)) < n;)
+            {
+                for (int v = first; v < min(first + 1024, n); v++)
+                {
+                    int d = at[v + 1] - at[v];
+                    double sum = 0;
+                    for (int e = at[v]; e < at[v + 1]; e++)
+                    {
+                        sum += max(weight[e], 0.0f);
+                    }
+                    small.clear();
+                    large.clear();
+                    for (int i = 0; i < d; i++)
+                    {
+                        prob[at[v] + i] = sum > 0 ? (float)(max(weight[at[v] + i], 0.0f) * d / sum) : 1;
+                        alias[at[v] + i] = i;
+                        (prob[at[v] + i] < 1 ? small : large).push_back(i);
+                    }
+                    while (!small.empty() && !large.empty())
+                    {
+                        int s = small.back(), l = large.back();
+                        small.pop_back();
+                        alias[at[v] + s] = l;
+                        prob[at[v] + l] -= 1 - prob[at[v] + s];
+                        if (prob[at[v] + l] < 1)
+                        {
+                            large.pop_back();
+                            small.push_back(l);
+                        }
+                    }
+                    // Whatever is left is 1 up to rounding.
+                    for (size_t i = 0; i < small.size(); i++)
+                    {
+                        prob[at[v] + small[i]] = 1;
+                    }
+                    for (size_t i = 0; i < large.size(); i++)
+                    {
+                        prob[at[v] + large[i]] = 1;
+                    }
+                }
+            }
+        };
+        run_on_threads(threads, run);
+    }
+
+    // One walk of `length` people from v into out[0..length), padded with
+    // walk_buffer::none if it reaches someone with no friends.
+    void walk(int v, int length, double p, double q, counter_rng &rng, uint32_t *out) const
+    {
+        double most = max(1.0, max(1 / p, 1 / q));
+        bool biased = p != 1 || q != 1;
+        int prev = -1;
+        for (int k = 0; k < length; k++)
+        {
+            if (v < 0 || at[v] == at[v + 1])
+            {
+                out[k] = walk_buffer::none;
+                v = -1;
+                continue;
+            }
+            out[k] = (uint32_t)v;
+            if (k + 1 == length)
+            {
+                break;
+            }
+            int next = step(v, rng);
+            while (prev >= 0 && biased)
+            {
+                double bias = next == prev ? 1 / p : adjacent(prev, next) ? 1 : 1 / q;
+                if (rng.unit() * most < bias)
+                {
+                    break;
+                }
+                next = step(v, rng);
+            }
+            prev = v;
+            v = next;
+        }
+    }
+
+    // `per_person` walks from everyone in `from` (everyone if empty), split
+    // across threads in chunks. Walk w is walk w % starts of round
+    // w / starts and draws from stream w, so the buffer is the same for any
+    // thread count.
+    walk_buffer walks(const vector<int> &from, int per_person, int length, double p, double q, unsigned long seed, int threads) const
+    {
+        vector<int> starts = from;
+        if (starts.empty())
+        {
+            starts.resize(at.size() - 1);
+            iota(starts.begin(), starts.end(), 0);
+        }
+        walk_buffer out;
+        out.count = (long)starts.size() * per_person;
+        out.length = length;
+        out.ids.resize((size_t)out.count * length);
+        threads = max(threads, 1);
+        atomic<long> cursor(0);
+        auto run = [&](int) {
+            STAT_PHASE(phase, "random walks");
+            for (long first; (first = cursor.fetch_add(256)) < out.count;)
+            {
+                for (long w = first; w < min(first + 256, out.count); w++)
+                {
+                    counter_rng rng(seed, (unsigned long)w);
+                    walk(starts[w % starts.size()], length, p, q, rng, &out.ids[(size_t)w * length]);
+                    STAT_ADD(visited, length);
+                }
+            }
+        };
+        run_on_threads(threads, run);
+        return out;
+    }
+};
+
+// Hops from s using only friendships formed within [from, to], -1 for
+// anyone out of reach; "formed before T" is the window [LONG_MIN, T - 1].
+// Each list is cut to the window by binary search, so friendships outside
+// it cost nothing.
+template <class G>
+vector<int> window_hops(const G &g, int s, long from, long to)
+{
+    vector<int> dist(g.size(), -1);
+    vector<int> frontier(1, s), next;
+    dist[s] = 0;
+    for (int level = 0; !frontier.empty(); level++)
+    {
+        STAT_PHASE(phase, "window bfs level");
+        STAT_ARGS(phase, level, (long)frontier.size());
+        STAT_ADD(visited, (long)frontier.size());
+        next.clear();
+        for (size_t i = 0; i < frontier.size(); i++)
+        {
+            g.for_each_friend_between(frontier[i], from, to, [&](int u, long) {
+                STAT_ADD(scanned, 1);
+                if (dist[u] < 0)
+                {
+                    dist[u] = level + 1;
+                    next.push_back(u);
+                }
+            });
+        }
+        frontier.swap(next);
+    }
+    return dist;
+}
+
+// Time-respecting reach: the earliest time each person can be reached from
+// s along a chain of friendships formed within [from, to], each formed no
+// earlier than the one before it, or LONG_MAX if never; s itself counts as
+// reached at `from`. Dijkstra on arrival time: once someone is settled only
+// their friendships formed at or after their arrival matter, and the time
+// ordered lists hand over exactly that slice.
+template <class G>
+vector<long> earliest_arrival(const G &g, int s, long from, long to)
+{
+    STAT_PHASE(phase, "earliest arrival");
+    vector<long> arrival(g.size(), LONG_MAX);
+    vector<char> done(g.size(), 0);
+    vector<pair<long, int>> heap(1, make_pair(from, s));
+    arrival[s] = from;
+    while (!heap.empty())
+    {
+        pop_heap(heap.begin(), heap.end(), greater<pair<long, int>>());
+        int v = heap.back().second;
+        heap.pop_back();
+        if (done[v])
+        {
+            continue;
+        }
+        done[v] = 1;
+        STAT_ADD(visited, 1);
+        g.for_each_friend_between(v, arrival[v], to, [&](int u, long t) {
+            STAT_ADD(scanned, 1);
+            if (t < arrival[u])
+            {
+                arrival[u] = t;
+                heap.push_back(make_pair(t, u));
+                push_heap(heap.begin(), heap.end(), greater<pair<long, int>>());
+            }
+        });
+    }
+    return arrival;
+}
+
+// MinHash sketches of everyone's friend set, for Jaccard similarity
+// without intersecting lists. Value i of a signature is the least h_i(u)
+// over the person's friends u, so two signatures agree there with
+// probability equal to the Jaccard similarity of the two sets, and the
+// fraction of agreeing values estimates it. Each h_i is a multiply-shift
+// of one mixed hash of u, so a friend costs one mix64 and a multiply-add
+// per value.
+//
+// For finding similar pairs the signatures are cut into `bands` of `rows`
+// values (LSH): people whose rows match in some band are candidates,
+// found through each band's buckets, a sorted array of (band hash,
+// person). A pair of similarity s becomes a candidate with probability
+// 1 - (1 - s^rows)^bands, which rises steeply around (1 / bands)^(1 /
+// rows); rows_for() picks rows to put that just under a threshold. People with
+// no friends have no signature and are never similar to anyone.
+class minhash
+{
+    int hashes;
+    int rows;
+    vector<uint32_t> sig;
+    vector<char> blank;
+    vector<vector<pair<unsigned long, int>>> buckets;
+
+    const uint32_t *of(int v) const
+    {
+        return &sig[(size_t)v * hashes];
+    }
+    unsigned long band_hash(int v, int b) const
+    {
+        unsigned long h = (unsigned long)b;
+        for (int r = 0; r < rows; r++)
+        {
+            h = mix64(h ^ (of(v)[b * rows + r] + 0x9e3779b97f4a7c15ul));
+        }
+        return h;
+    }
+    bool same_band(int a, int b, int band) const
+    {
+        return equal(of(a) + band * rows, of(a) + (band + 1) * rows, of(b) + band * rows);
+    }
+
+public:
+    // Signatures of bands * rows values, hashed in one parallel pass over
+    // the lists, then each band's buckets sorted by a thread of its own.
+    template <class G>
+    minhash(const G &g, int bands, int rows_per_band, int threads, unsigned long seed = 1) : hashes(bands * rows_per_band), rows(rows_per_band), sig((size_t)g.size() * bands * rows_per_band, 0xFFFFFFFFu), blank(g.size(), 1), buckets(bands)
+    {
+        int n = g.size();
+        threads = max(threads, 1);
+        vector<unsigned long> a(hashes), c(hashes);
+        for (int i = 0; i < hashes; i++)
+        {
+            a[i] = mix64(seed * 0x9e3779b97f4a7c15ul + 2 * i) | 1;
+            c[i] = mix64(seed * 0x9e3779b97f4a7c15ul + 2 * i + 1);
+        }
+        atomic<int> cursor(0);
+        run_on_threads(threads, [&](int) {
+            STAT_PHASE(phase, "minhash signatures");
+            for (int first; (first = cursor.fetch_add(256)) < n;)
+            {
+                for (int v = first; v < min(first + 256, n); v++)
+                {
+                    uint32_t *out = &sig[(size_t)v * hashes];
+                    g.for_each_friend(v, [&](int u) {
+                        unsigned long x = mix64((unsigned long)u + seed);
+                        for (int i = 0; i < hashes; i++)
+                        {
+                            out[i] = min(out[i], (uint32_t)((a[i] * x + c[i]) >> 32));
+                        }
+                    });
+                    blank[v] = g.degree(v) == 0;
+                    STAT_ADD(scanned, g.degree(v));
+                }
+            }
+        });
+        atomic<int> next(0);
+        run_on_threads(threads, [&](int) {
+            STAT_PHASE(phase, "lsh buckets");
+            for (int b; (b = next.fetch_add(1)) < bands;)
+            {
+                for (int v = 0; v < n; v++)
+                {
+                    if (!blank[v])
+                    {
+                        buckets[b].push_back(make_pair(band_hash(v, b), v));
+                    }
+                }
+                sort(buckets[b].begin(), buckets[b].end());
+            }
+        });
+    }
+
+    // The most rows per band (a divisor of `hashes`) whose LSH threshold
+    // is still at or below `threshold`. Candidates are checked against
+    // their estimate anyway, so erring low trades a little work for recall.
+    static int rows_for(double threshold, int hashes)
+    {
+        int best = 1;
+        for (int r = 1; r <= hashes; r++)
+        {
+            if (hashes % r == 0 && pow(1.0 / (hashes / r), 1.0 / r) <= threshold)
+            {
+                best = r;
+            }
+        }
+        return best;
+    }
+    int bands() const
+    {
+        return (int)buckets.size();
+    }
+    // Estimated Jaccard similarity of a's and b's friend sets.
+    double similarity(int a, int b) const
+    {
+        if (blank[a] || blank[b])
+        {
+            return 0;
+        }
+        int agree = 0;
+        for (int i = 0; i < hashes; i++)
+        {
+            agree += of(a)[i] == of(b)[i];
+        }
+        return (double)agree / hashes;
+    }
+
+    // Up to k people most like v, as (estimated similarity, person) best
+    // first, from v's LSH candidates only; those estimated below
+    // `threshold` are dropped.
+    vector<pair<double, int>> similar(int v, int k, double threshold) const
+    {
+        vector<int> seen;
+        if (blank[v])
+        {
+            return vector<pair<double, int>>();
+        }
+        for (int b = 0; b < bands(); b++)
+        {
+            unsigned long h = band_hash(v, b);
+            vector<pair<unsigned long, int>>::const_iterator it = lower_bound(buckets[b].begin(), buckets[b].end(), make_pair(h, INT_MIN));
+            for (; it != buckets[b].end() && it->first == h; it++)
+            {
+                if (it->second != v && same_band(v, it->second, b))
+                {
+                    seen.push_back(it->second);
+                }
+            }
+        }
+        sort(seen.begin(), seen.end());
+        seen.erase(unique(seen.begin(), seen.end()), seen.end());
+        vector<pair<double, int>> best;
+        for (size_t i = 0; i < seen.size(); i++)
+        {
+            double s = similarity(v, seen[i]);
+            if (s >= threshold)
+            {
+                best.push_back(make_pair(s, seen[i]));
+            }
+        }
+        auto better = [](const pair<double, int> &x, const pair<double, int> &y) {
+            return x.first != y.first ? x.first > y.first : x.second < y.second;
+        };
+        size_t keep = min(best.size(), (size_t)max(k, 0));
+        partial_sort(best.begin(), best.begin() + keep, best.end(), better);
+        best.resize(keep);
+        return best;
+    }
+
+    // Every pair (a < b) that shares a band and is estimated at least
+    // `threshold` similar, sorted. A pair is only taken in the first band
+    // its rows match in, so no pair is produced twice; bands are split
+    // across threads.
+    vector<pair<int, int>> pairs(double threshold, int threads) const
+    {
+        threads = max(threads, 1);
+        vector<vector<pair<int, int>>> found(threads);
+        atomic<int> next(0);
+        run_on_threads(threads, [&](int t) {
+            STAT_PHASE(phase, "lsh pairs");
+            for (int b; (b = next.fetch_add(1)) < bands();)
+            {
+                const vector<pair<unsigned long, int>> &bucket = buckets[b];
+                for (size_t i = 0, j; i < bucket.size(); i = j)
+                {
+                    for (j = i + 1; j < bucket.size() && bucket[j].first == bucket[i].first; j++)
+                    {
+                    }
+                    for (size_t x = i; x < j; x++)
+                    {
+                        for (size_t y = x + 1; y < j; y++)
+                        {
+                            int u = bucket[x].second, w = bucket[y].second;
+                            if (!same_band(u, w, b) || similarity(u, w) < threshold)
+                            {
+                                continue;
+                            }
+                            bool earlier = false;
+                            for (int e = 0; e < b && !earlier; e++)
+                            {
+                                earlier = same_band(u, w, e);
+                            }
+                            if (!earlier)
+                            {
+                                found[t].push_back(make_pair(u, w));
+                            }
+                        }
+                    }
+                }
+            }
+        });
+        vector<pair<int, int>> all;
+        for (int t = 0; t < threads; t++)
+        {
+            all.insert(all.end(), found[t].begin(), found[t].end());
+        }
+        sort(all.begin(), all.end());
+        return all;
+    }
+};
+
+// Read-only view of part of a graph: the people in `members` (parent ids,
+// ascending) and the friendships among them, under local ids 0..k-1 in
+// parent id order. Nothing of the adjacency is copied; each list is the
+// parent's, filtered through a binary search of `members` as it's walked,
+// and stays sorted because local ids follow parent ids. Only the member
+// list and in-view degrees are kept, so a view costs the size of the
+// circle. A view has the interface kernels expect of G, so any of them
+// runs on one unchanged, and views of views work too. The parent must
+// outlive the view.
+template <class G>
+class subgraph_view
+{
+    const G *parent;
+    vector<int> members;
+    vector<int> deg;
+    long total;
+
+public:
+    subgraph_view(const G &g, vector<int> people) : parent(&g), members(people), total(0)
+    {
+        sort(members.begin(), members.end());
+        members.erase(unique(members.begin(), members.end()), members.end());
+        deg.assign(members.size(), 0);
+        for (size_t v = 0; v < members.size(); v++)
+        {
+            g.for_each_friend(members[v], [&](int u) {
+                deg[v] += local(u) >= 0;
+            });
+            total += deg[v];
+        }
+    }
+
+    // Local id of parent id u, or -1 if u isn't in the view.
+    int local(int u) const
+    {
+        vector<int>::const_iterator it = lower_bound(members.begin(), members.end(), u);
+        return it != members.end() && *it == u ? (int)(it - members.begin()) : -1;
+    }
+    int global(int v) const
+    {
+        return members[v];
+    }
+    long ver() const
+    {
+        return parent->ver();
+    }
+    bool symmetric() const
+    {
+        return parent->symmetric();
+    }
+    bool weighted() const
+    {
+        return parent->weighted();
+    }
+    bool whole() const
+    {
+        return parent->whole();
+    }
+    int size() const
+    {
+        return (int)members.size();
+    }
+    long edges() const
+    {
+        return total;
+    }
+    int degree(int v) const
+    {
+        return deg[v];
+    }
+    const string &name(int v) const
+    {
+        return parent->name(members[v]);
+    }
+    int id(const string &who) const
+    {
+        int u = parent->id(who);
+        return u < 0 ? -1 : local(u);
+    }
+    bool present(int v) const
+    {
+        return parent->present(members[v]);
+    }
+    template <class F>
+    void for_each_friend(int v, F f) const
+    {
+        parent->for_each_friend(members[v], [&](int u) {
+            int l = local(u);
+            if (l >= 0)
+            {
+                f(l);
+            }
+        });
+    }
+    template <class F>
+    void for_each_edge(int v, F f) const
+    {
+        parent->for_each_edge(members[v], [&](int u, float w) {
+            int l = local(u);
+            if (l >= 0)
+            {
+                f(l, w);
+            }
+        });
+    }
+    template <class F>
+    void for_each_upper(int v, F f) const
+    {
+        parent->for_each_upper(members[v], [&](int u) {
+            int l = local(u);
+            if (l >= 0)
+            {
+                f(l);
+            }
+        });
+    }
+    template <class F>
+    void for_each_friend_between(int v, long from, long to, F f) const
+    {
+        parent->for_each_friend_between(members[v], from, to, [&](int u, long t) {
+            int l = local(u);
+            if (l >= 0)
+            {
+                f(l, t);
+            }
+        });
+    }
+    template <class P>
+    int find_friend(int v, P pred) const
+    {
+        int u = parent->find_friend(members[v], [&](int u) {
+            int l = local(u);
+            return l >= 0 && pred(l);
+        });
+        return u < 0 ? -1 : local(u);
+    }
+};
+
+// The view of everyone within `radius` hops of v. The BFS keeps who it has
+// seen in a hash set rather than an array over everyone, so it costs the
+// circle, not the graph.
+template <class G>
+subgraph_view<G> ego_view(const G &g, int v, int radius)
+{
+    unordered_set<int> seen;
+    vector<int> frontier(1, v), next, members(1, v);
+    seen.insert(v);
+    for (int level = 0; level < radius && !frontier.empty(); level++)
+    {
+        next.clear();
+        for (size_t i = 0; i < frontier.size(); i++)
+        {
+            g.for_each_friend(frontier[i], [&](int u) {
+                if (seen.insert(u).second)
+                {
+                    next.push_back(u);
+                    members.push_back(u);
+                }
+            });
+        }
+        frontier.swap(next);
+    }
+    return subgraph_view<G>(g, members);
+}
+
+int graph::isthere(string fren)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (fren == head[i]->name && !head[i]->dead)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int graph::where(string fren)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (fren == head[i]->name && !head[i]->dead)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void graph::create()
+{
+    string fren;
+    char ch;
+    for (int i = 0; i < n; i++)
+    {
+        do
+        {
+            cout << "\nEnter friend of " << head[i]->name << ": \n";
+            cin >> fren;
+            if (fren == head[i]->name)
+            {
+                cout << "They can't be their own friend!! Try again\n";
+            }
+            else if (!isthere(fren))
+            {
+                cout << "No such person exists!!\n";
+            }
+            else
+            {
+                int j = where(fren);
+                float w = 1;
+                if (weighted)
+                {
+                    cout << "Strength of friendship: ";
+                    cin >> w;
+                }
+                if (w < 0)
+                {
+                    cout << "Strength can't be negative!! Try again\n";
+                }
+                else
+                {
+                    lock_guard<mutex> hold(lists);
+                    long t = (long)time(NULL);
+                    link(i, j, w, t);
+                    if (undirected)
+                    {
+                        link(j, i, w, t);
+                    }
+                    pending.friendships.push_back(make_pair(i, j));
+                    if (weighted)
+                    {
+                        pending.strength.push_back(w);
+                    }
+                    pending.formed.push_back(t);
+                }
+            }
+            cout << "Are there more adjacent nodes? (y/n): ";
+            cin >> ch;
+
+        } while (ch == 'y');
+        commit();
+    }
+}
+
+// Must hold `lists`. Appends b to a's friend list unless they're already
+// there; a tombstoned entry is brought back instead. Either way the
+// friendship ends up with strength w, formed at time t.
+void graph::link(int a, int b, float w, long t)
+{
+    unordered_map<long, gnode *>::iterator it = edge_at.find(key(a, b));
+    if (it != edge_at.end())
+    {
+        it->second->weight = w;
+        it->second->formed = t;
+        if (it->second->dead)
+        {
+            it->second->dead = false;
+            dead_edges--;
+            links[a]++;
+            links[b]++;
+            mutations++;
+        }
+        return;
+    }
+    gnode *temp = head[a];
+    while (temp->next != NULL)
+    {
+        temp = temp->next;
+    }
+    gnode *curr = new gnode;
+    curr->name = head[b]->name;
+    curr->id = b;
+    curr->dead = false;
+    curr->weight = w;
+    curr->formed = t;
+    curr->next = NULL;
+    temp->next = curr;
+    edge_at[key(a, b)] = curr;
+    mutations++;
+    total_edges++;
+    links[a]++;
+    links[b]++;
+}
+
+// Must hold `lists`. Marks the friendship a -> b dead in O(1).
+bool graph::tombstone(int a, int b)
+{
+    unordered_map<long, gnode *>::iterator it = edge_at.find(key(a, b));
+    if (it == edge_at.end() || it->second->dead)
+    {
+        return false;
+    }
+    it->second->dead = true;
+    mutations++;
+    dead_edges++;
+    links[a]--;
+    links[b]--;
+    return true;
+}
+
+void graph::unfriend()
+{
+    string a, b;
+    cout << "Please enter names of the two friends/nodes: ";
+    cin >> a >> b;
+    unique_lock<mutex> hold(lists);
+    if (!isthere(a) || !isthere(b))
+    {
+        cout << "Please enter valid nodes!\n";
+        return;
+    }
+    int x = where(a), y = where(b);
+    bool found = tombstone(x, y);
+    if (undirected)
+    {
+        found = tombstone(y, x) || found;
+    }
+    if (!found)
+    {
+        cout << a << " and " << b << " aren't friends!\n";
+        return;
+    }
+    pending.unfriended.push_back(make_pair(x, y));
+    maybe_compact();
+    hold.unlock();
+    commit();
+}
+
+void graph::remove()
+{
+    string v;
+    cout << "Please enter name of friend/node you'd like to remove: ";
+    cin >> v;
+    unique_lock<mutex> hold(lists);
+    if (!isthere(v))
+    {
+        cout << "Please enter a valid node!\n";
+        return;
+    }
+    depart(where(v));
+    maybe_compact();
+    hold.unlock();
+    commit();
+}
+
+// Must hold `lists`.
+void graph::maybe_compact()
+{
+    if (dead_edges == 0 || dead_edges < compact_at * total_edges)
+    {
+        return;
+    }
+    if (!background)
+    {
+        compact();
+        return;
+    }
+    if (compacting)
+    {
+        return;
+    }
+    compacting = true;
+    if (compactor.joinable())
+    {
+        compactor.join();
+    }
+    compactor = thread([this] {
+        lock_guard<mutex> hold(lists);
+        compact();
+        compacting = false;
+    });
+}
+
+// Must hold `lists`. Unlinks every tombstoned friendship and every entry
+// touching a removed person.
+void graph::compact()
+{
+    for (int i = 0; i < n; i++)
+    {
+        gnode *temp = head[i];
+        while (temp->next != NULL)
+        {
+            gnode *curr = temp->next;
+            if (!head[i]->dead && !gone(curr))
+            {
+                temp = curr;
+                continue;
+            }
+            if (!curr->dead)
+            {
+                links[i]--;
+                links[curr->id]--;
+            }
+            edge_at.erase(key(i, curr->id));
+            temp->next = curr->next;
+            delete curr;
+            total_edges--;
+        }
+    }
+    dead_edges = 0;
+}
+
+// Must hold `lists`.
+void graph::depart(int x)
+{
+    head[x]->dead = true;
+    mutations++;
+    dead_edges = min(total_edges, dead_edges + links[x]);
+    links[x] = 0;
+    pending.departed.push_back(x);
+}
+
+// Publishes the pending changes, logging them first when there is a log.
+// Returns once they are durable.
+void graph::commit()
+{
+    if (journal.is_open() && !pending.empty() && !journal.wait(journal.append(pending)))
+    {
+        cout << "Couldn't write the log; recent changes may not survive a restart\n";
+    }
+    published.publish(pending);
+    pending = delta();
+    if (journal.is_open() && journal.due())
+    {
+        checkpoint();
+    }
+}
+
+// Must hold `lists`. Replays a logged delta onto the lists and queues it
+// for publication, the same way create(), unfriend() and remove() would.
+// Returns false, changing nothing, if it would take the graph past the 20
+// people it has room for.
+bool graph::apply(const delta &d)
+{
+    if (d.people.size() > (size_t)(20 - n))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < d.people.size(); i++)
+    {
+        head[n] = new gnode;
+        head[n]->name = d.people[i];
+        head[n]->id = n;
+        head[n]->dead = false;
+        head[n]->weight = 0;
+        head[n]->formed = 0;
+        head[n]->next = NULL;
+        links[n] = 0;
+        pending.people.push_back(d.people[i]);
+        n++;
+    }
+    for (size_t i = 0; i < d.friendships.size(); i++)
+    {
+        int a = d.friendships[i].first, b = d.friendships[i].second;
+        float w = i < d.strength.size() ? d.strength[i] : 1;
+        long t = i < d.formed.size() ? d.formed[i] : 0;
+        if (a >= n || b >= n)
+        {
+            continue;
+        }
+        link(a, b, w, t);
+        if (undirected)
+        {
+            link(b, a, w, t);
+        }
+        pending.friendships.push_back(d.friendships[i]);
+        if (weighted)
+        {
+            pending.strength.push_back(w);
+        }
+        pending.formed.push_back(t);
+    }
+    for (size_t i = 0; i < d.unfriended.size(); i++)
+    {
+        int a = d.unfriended[i].first, b = d.unfriended[i].second;
+        if (a < n && b < n && (tombstone(a, b) | (undirected && tombstone(b, a))))
+        {
+            pending.unfriended.push_back(d.unfriended[i]);
+        }
+    }
+    for (size_t i = 0; i < d.departed.size(); i++)
+    {
+        if (d.departed[i] < n && !head[d.departed[i]]->dead)
+        {
+            depart(d.departed[i]);
+        }
+    }
+    return true;
+}
+
+// Must hold `lists`. The whole graph as one delta: everyone ever added, in
+// order, their live friendships and who has left.
+delta graph::state()
+{
+    delta d;
+    for (int i = 0; i < n; i++)
+    {
+        d.people.push_back(head[i]->name);
+        if (head[i]->dead)
+        {
+            d.departed.push_back(i);
+            continue;
+        }
+        for (gnode *e = head[i]->next; e != NULL; e = e->next)
+        {
+            if (gone(e) || (undirected && e->id < i))
+            {
+                continue;
+            }
+            d.friendships.push_back(make_pair(i, e->id));
+            if (weighted)
+            {
+                d.strength.push_back(e->weight);
+            }
+            d.formed.push_back(e->formed);
+        }
+    }
+    return d;
+}
+
+void graph::checkpoint()
+{
+    delta now;
+    {
+        lock_guard<mutex> hold(lists);
+        now = state();
+    }
+    if (!journal.checkpoint(now, undirected, weighted))
+    {
+        cout << "Couldn't write a checkpoint of the log\n";
+    }
+}
+
+// Rebuilds the lists from the checkpoint and log at `log`, publishing one
+// version per logged commit so a friendship dropped and re-added replays
+// in order.
+void graph::restore(const string &log)
+{
+    delta saved;
+    vector<delta> tail;
+    n = 0;
+    if (!journal.open(log, saved, tail))
+    {
+        cout << "Can't recover from " << log << "\n";
+        return;
+    }
+    lock_guard<mutex> hold(lists);
+    // Stopping short would leave later friendships pointing at people who
+    // were never added, so a log with too many people isn't recovered at
+    // all and is left untouched.
+    for (size_t i = 0; i <= tail.size(); i++)
+    {
+        if (!apply(i == 0 ? saved : tail[i - 1]))
+        {
+            cout << "Can't recover from " << log << ": it holds more than 20 people\n";
+            journal.abandon();
+            return;
+        }
+        published.publish(pending);
+        pending = delta();
+    }
+    cout << "Recovered " << n << " people and " << tail.size() << " logged changes from " << log << "\n";
+}
+
+void graph::path()
+{
+    string a, b;
+    cout << "Please enter names of the two friends/nodes: ";
+    cin >> a >> b;
+    snapshot_store::reader snap = pin();
+    int s = snap->id(a), t = snap->id(b);
+    if (s < 0 || t < 0)
+    {
+        cout << "Please enter valid nodes!\n";
+        return;
+    }
+    vector<int> p = shortest_path(*snap, s, t);
+    if (p.empty())
+    {
+        cout << "\n"
+             << a << " can't reach " << b << "\n";
+        return;
+    }
+    cout << "\n"
+         << p.size() - 1 << " hop(s): " << snap->name(p[0]);
+    for (size_t i = 1; i < p.size(); i++)
+    {
+        cout << " -> " << snap->name(p[i]);
+    }
+    cout << "\n";
+}
+
+// Head nodes are the vertex headers; every list entry is a separately
+// allocated gnode carrying its own copy of the friend's name, plus a node in
+// the (from, to) index.
+memory_report graph::memory()
+{
+    lock_guard<mutex> hold(lists);
+    memory_report r;
+    r.headers = sizeof(graph) - sizeof(visit);
+    r.visited = sizeof(visit);
+    for (int i = 0; i < n; i++)
+    {
+        r.heap(r.headers, sizeof(gnode));
+        r.name(head[i]->name);
+        for (gnode *temp = head[i]->next; temp != NULL; temp = temp->next)
+        {
+            r.heap(r.adjacency, sizeof(gnode));
+            r.name(temp->name);
+        }
+    }
+    r.heap(r.adjacency, edge_at.bucket_count() * sizeof(void *));
+    for (size_t i = 0; i < edge_at.size(); i++)
+    {
+        r.heap(r.adjacency, sizeof(void *) + sizeof(pair<const long, gnode *>));
+    }
+    return r;
+}
+
+// Prints the traversal counters summed over all threads and writes the
+// timed phases to `path` as a Chrome trace.
+void report_stats(const string &path)
+{
+#ifdef GRAPH_STATS
+    stat_block sum = stats::merged();
+    cout << "\nPeople visited:       " << sum.visited;
+    cout << "\nFriendships scanned:  " << sum.scanned;
+    cout << "\nBFS levels:           " << sum.levels;
+    cout << "\nDirection switches:   " << sum.switches << "\n";
+    ofstream out(path.c_str());
+    stats::trace(out);
+    cout << "Trace written to " << path << "\n";
+#else
+    cout << "Traversal stats are off; rebuild with -DGRAPH_STATS to collect them\n";
+    (void)path;
+#endif
+}
+
+void graph::usage()
+{
+    memory().print("Friend lists:");
+    snapshot_store::reader snap = pin();
+    snap->memory().print("Published snapshot:");
+}
+
+void graph::weighted_path()
+{
+    string a, b;
+    cout << "Please enter names of the two friends/nodes: ";
+    cin >> a >> b;
+    snapshot_store::reader snap = pin();
+    int s = snap->id(a), t = snap->id(b);
+    if (s < 0 || t < 0)
+    {
+        cout << "Please enter valid nodes!\n";
+        return;
+    }
+    vector<int> parent;
+    vector<double> dist = dijkstra(*snap, s, parent, t);
+    if (parent[t] < 0)
+    {
+        cout << "\n"
+             << a << " can't reach " << b << "\n";
+        return;
+    }
+    vector<int> p;
+    for (int v = t; v != s; v = parent[v])
+    {
+        p.push_back(v);
+    }
+    cout << "\nTotal strength " << dist[t] << ": " << a;
+    for (size_t i = p.size(); i-- > 0;)
+    {
+        cout << " -> " << snap->name(p[i]);
+    }
+    cout << "\n";
+}
+
+void graph::reach()
+{
+    string v;
+    cout << "Please enter name of friend/node you'd like to start with: ";
+    cin >> v;
+    snapshot_store::reader snap = pin();
+    int s = snap->id(v);
+    if (s < 0)
+    {
+        cout << "Please enter a valid node!\n";
+        return;
+    }
+    vector<char> seen = reachable(*snap, s, (int)thread::hardware_concurrency());
+    int count = 0;
+    for (size_t u = 0; u < seen.size(); u++)
+    {
+        if (seen[u] && (int)u != s)
+        {
+            cout << "\n"
+                 << snap->name(u);
+            count++;
+        }
+    }
+    cout << "\n"
+         << v << " can reach " << count << " people\n";
+}
+
+void graph::suggest()
+{
+    string v;
+    int k, rank;
+    cout << "Please enter name of friend/node: ";
+    cin >> v;
+    cout << "How many suggestions? ";
+    cin >> k;
+    cout << "Rank by 1. Friends in common 2. Adamic-Adar: ";
+    cin >> rank;
+    snapshot_store::reader snap = pin();
+    int s = snap->id(v);
+    if (s < 0)
+    {
+        cout << "Please enter a valid node!\n";
+        return;
+    }
+    accumulator acc;
+    acc.reset(snap->size());
+    vector<pair<double, int>> best = recommend(*snap, s, k, rank == 2, acc);
+    if (best.empty())
+    {
+        cout << "\nNo suggestions for " << v << "\n";
+    }
+    for (size_t i = 0; i < best.size(); i++)
+    {
+        cout << "\n"
+             << snap->name(best[i].second) << " (" << best[i].first << ")";
+    }
+    cout << "\n";
+}
+
+void graph::bridges()
+{
+    int pivots;
+    cout << "How many sample sources? (0 for exact): ";
+    cin >> pivots;
+    snapshot_store::reader snap = pin();
+    vector<double> score = betweenness(*snap, (int)thread::hardware_concurrency(), pivots);
+    vector<int> rank;
+    for (int v = 0; v < snap->size(); v++)
+    {
+        if (snap->present(v))
+        {
+            rank.push_back(v);
+        }
+    }
+    size_t top = min(rank.size(), (size_t)5);
+    partial_sort(rank.begin(), rank.begin() + top, rank.end(), [&](int a, int b) {
+        return score[a] > score[b];
+    });
+    for (size_t i = 0; i < top; i++)
+    {
+        cout << "\n"
+             << snap->name(rank[i]) << " (" << score[rank[i]] << ")";
+    }
+    cout << "\n";
+}
+
+void graph::communities_of()
+{
+    unsigned seed;
+    cout << "Seed: ";
+    cin >> seed;
+    snapshot_store::reader snap = pin();
+    communities found = propagate_labels(*snap, seed, 1);
+    for (size_t c = 0; c < found.size.size(); c++)
+    {
+        string members;
+        for (int v = 0; v < snap->size(); v++)
+        {
+            if (found.of[v] == (int)c && snap->present(v))
+            {
+                members += " " + snap->name(v);
+            }
+        }
+        if (!members.empty())
+        {
+            cout << "\nCommunity " << c + 1 << " (" << found.size[c] << "):" << members;
+        }
+    }
+    cout << "\nSettled after " << found.rounds << " round(s)\n";
+}
+
+// Answers from the distance index, rebuilding it first if friendships have
+// changed since it was built.
+void graph::hop_distance()
+{
+    string a, b;
+    cout << "Please enter names of the two friends/nodes: ";
+    cin >> a >> b;
+    snapshot_store::reader snap = pin();
+    int s = snap->id(a), t = snap->id(b);
+    if (s < 0 || t < 0)
+    {
+        cout << "Please enter valid nodes!\n";
+        return;
+    }
+    if (!hop_index.ready_for(snap->ver()))
+    {
+        hop_index.build(*snap, snap->ver());
+        cout << "Built distance index with " << hop_index.entries() << " label entries\n";
+    }
+    int d = hop_index.distance(s, t);
+    if (d < 0)
+    {
+        cout << "\n"
+             << a << " can't reach " << b << "\n";
+    }
+    else
+    {
+        cout << "\n"
+             << a << " is " << d << " hop(s) from " << b << "\n";
+    }
+}
+
+// Writes the current snapshot, or one person's ego network or group, to a
+// DOT or GraphML file.
+void graph::export_graph()
+{
+    string format, path, scope, who;
+    cout << "Format (dot/graphml): ";
+    cin >> format;
+    if (format != "dot" && format != "graphml")
+    {
+        cout << "Please choose dot or graphml!\n";
+        return;
+    }
+    cout << "File name: ";
+    cin >> path;
+    cout << "Export everyone, one person's ego network or their group? (all/ego/group): ";
+    cin >> scope;
+    snapshot_store::reader snap = pin();
+    vector<char> keep;
+    if (scope == "ego" || scope == "group")
+    {
+        cout << "Whose? ";
+        cin >> who;
+        int v = snap->id(who);
+        if (v < 0)
+        {
+            cout << "Please enter a valid node!\n";
+            return;
+        }
+        int radius = 0;
+        if (scope == "ego")
+        {
+            cout << "Within how many hops? ";
+            cin >> radius;
+        }
+        keep = scope == "ego" ? ego_mask(*snap, v, radius) : group_mask(*snap, v);
+    }
+    else if (scope != "all")
+    {
+        cout << "Please choose all, ego or group!\n";
+        return;
+    }
+    buffered_sink out(path);
+    if (format == "dot")
+    {
+        export_dot(*snap, out, keep);
+    }
+    else
+    {
+        export_graphml(*snap, out, keep);
+    }
+    cout << (out.flush() ? "Wrote " : "Couldn't write ") << path << "\n";
+}
+
+// Who a person reaches through friendships formed in a window of the
+// last few minutes, and who hears from them if news can only travel along
+// friendships in the order they were made.
+void graph::over_time()
+{
+    string who;
+    long older, newer;
+    cout << "Whose reach? ";
+    cin >> who;
+    snapshot_store::reader snap = pin();
+    int v = snap->id(who);
+    if (v < 0 || !snap->present(v))
+    {
+        cout << "Please enter a valid node!\n";
+        return;
+    }
+    cout << "Friendships formed between how many minutes ago and how many minutes ago? (e.g. 60 0) ";
+    cin >> older >> newer;
+    if (older < newer || newer < 0)
+    {
+        cout << "Please enter the older time first, neither negative!\n";
+        return;
+    }
+    long now = (long)time(NULL), from = now - older * 60, to = now - newer * 60;
+    vector<int> d = window_hops(*snap, v, from, to);
+    vector<long> first = earliest_arrival(*snap, v, from, to);
+    int shown = 0;
+    for (int u = 0; u < snap->size(); u++)
+    {
+        if (u != v && d[u] > 0 && snap->present(u))
+        {
+            cout << "\n"
+                 << snap->name(u) << ": " << d[u] << " hop(s)";
+            if (first[u] != LONG_MAX)
+            {
+                cout << ", in order by " << (now - first[u]) / 60 << " minute(s) ago";
+            }
+            shown++;
+        }
+    }
+    cout << (shown ? "\n" : "\nNobody within that window\n");
+}
+
+// People whose friends are most like someone's, by estimated Jaccard
+// similarity from MinHash sketches rather than intersecting friend lists.
+void graph::similar_people()
+{
+    string who;
+    int k;
+    double threshold;
+    cout << "Similar to whom? ";
+    cin >> who;
+    snapshot_store::reader snap = pin();
+    int v = snap->id(who);
+    if (v < 0 || !snap->present(v))
+    {
+        cout << "Please enter a valid node!\n";
+        return;
+    }
+    cout << "How many, and at least how similar (0 to 1)? ";
+    cin >> k >> threshold;
+    const int hashes = 64;
+    minhash sketch(*snap, hashes / minhash::rows_for(threshold, hashes), minhash::rows_for(threshold, hashes), (int)thread::hardware_concurrency());
+    vector<pair<double, int>> best = sketch.similar(v, k, threshold);
+    if (best.empty())
+    {
+        cout << "\nNobody much like " << who << "\n";
+    }
+    for (size_t i = 0; i < best.size(); i++)
+    {
+        cout << "\n"
+             << snap->name(best[i].second) << " (about " << best[i].first << ")";
+    }
+    cout << "\n";
+}
+
+// A few random walks from one person, uniform or by strength, with
+// node2vec's return (p) and in-out (q) parameters.
+void graph::random_walks()
+{
+    string who;
+    int count, length;
+    double p, q;
+    cout << "Walk from whom? ";
+    cin >> who;
+    snapshot_store::reader snap = pin();
+    int v = snap->id(who);
+    if (v < 0 || !snap->present(v))
+    {
+        cout << "Please enter a valid node!\n";
+        return;
+    }
+    cout << "How many walks, and how long? ";
+    cin >> count >> length;
+    cout << "Return and in-out parameters (p q, 1 1 for plain walks): ";
+    cin >> p >> q;
+    if (count <= 0 || length <= 0 || !(p > 0) || !(q > 0))
+    {
+        cout << "Please enter positive numbers!\n";
+        return;
+    }
+    int threads = (int)thread::hardware_concurrency();
+    walker paths(*snap, snap->weighted(), threads);
+    walk_buffer found = paths.walks(vector<int>(1, v), count, length, p, q, (unsigned long)time(NULL), threads);
+    for (long w = 0; w < found.count; w++)
+    {
+        cout << "\n";
+        const uint32_t *at = found.walk(w);
+        for (int k = 0; k < length && at[k] != walk_buffer::none; k++)
+        {
+            cout << (k ? " -> " : "") << snap->name((int)at[k]);
+        }
+    }
+    cout << "\n";
+}
+
+// Estimated number of people each person reaches within k hops, from
+// HyperANF rather than a BFS per person.
+void graph::reach_estimates()
+{
+    int k;
+    cout << "Within how many hops? ";
+    cin >> k;
+    if (k < 0)
+    {
+        cout << "Please enter a non-negative number of hops!\n";
+        return;
+    }
+    snapshot_store::reader snap = pin();
+    neighbourhood found = hyper_anf(*snap, k, (int)thread::hardware_concurrency());
+    for (int v = 0; v < snap->size(); v++)
+    {
+        if (snap->present(v))
+        {
+            cout << "\n"
+                 << snap->name(v) << " reaches about " << (long)(found.reach[v] - 0.5f) << " other people within " << k << " hop(s)";
+        }
+    }
+    cout << "\nEffective diameter: about " << found.effective_diameter << " hops\n";
+}
+
+// Follow circles: people who can all reach each other along friendships,
+// listed so that a circle only leads into circles printed after it.
+void graph::circles()
+{
+    snapshot_store::reader snap = pin();
+    strong_components found = strongly_connected(*snap);
+    vector<string> members(found.count());
+    for (int v = 0; v < snap->size(); v++)
+    {
+        if (snap->present(v))
+        {
+            members[found.of[v]] += " " + snap->name(v);
+        }
+    }
+    vector<int> number(found.count(), 0);
+    int shown = 0;
+    for (int c = 0; c < found.count(); c++)
+    {
+        if (!members[c].empty())
+        {
+            number[c] = ++shown;
+        }
+    }
+    for (int c = 0; c < found.count(); c++)
+    {
+        if (number[c] == 0)
+        {
+            continue;
+        }
+        cout << "\nCircle " << number[c] << ":" << members[c];
+        string next;
+        for (int e = found.dag_at[c]; e < found.dag_at[c + 1]; e++)
+        {
+            if (number[found.dag[e]] > 0)
+            {
+                next += " " + to_string(number[found.dag[e]]);
+            }
+        }
+        if (!next.empty())
+        {
+            cout << "  (leads to" << next << ")";
+        }
+    }
+    cout << "\n";
+}
+
+void graph::groups()
+{
+    snapshot_store::reader snap = pin();
+    vector<int> label = components(*snap);
+    int count = 0;
+    for (size_t v = 0; v < label.size(); v++)
+    {
+        count = max(count, label[v] + 1);
+    }
+    int shown = 0;
+    for (int c = 0; c < count; c++)
+    {
+        string members;
+        for (size_t v = 0; v < label.size(); v++)
+        {
+            if (label[v] == c && snap->present(v))
+            {
+                members += " " + snap->name(v);
+            }
+        }
+        if (!members.empty())
+        {
+            cout << "\nGroup " << ++shown << ":" << members;
+        }
+    }
+    cout << "\n";
+}
+
+// Someone's circle, everyone within a few hops, looked at on its own:
+// the kernels run on a view of the snapshot, so this costs the circle
+// rather than the whole graph.
+void graph::explore_circle()
+{
+    string who;
+    int radius;
+    cout << "Whose circle? ";
+    cin >> who;
+    snapshot_store::reader snap = pin();
+    int v = snap->id(who);
+    if (v < 0 || !snap->present(v))
+    {
+        cout << "Please enter a valid node!\n";
+        return;
+    }
+    cout << "Within how many hops? ";
+    cin >> radius;
+    if (radius < 0)
+    {
+        cout << "Please enter a non-negative number of hops!\n";
+        return;
+    }
+    subgraph_view<snapshot> circle = ego_view(*snap, v, radius);
+    vector<int> label = components(circle);
+    cout << "\n"
+         << circle.size() << " people in " << who << "'s circle, "
+         << (snap->symmetric() ? circle.edges() / 2 : circle.edges()) << " friendship(s) among them, in "
+         << (label.empty() ? 0 : *max_element(label.begin(), label.end()) + 1) << " group(s)";
+    if (snap->symmetric())
+    {
+        cout << "\n"
+             << count_triangles(circle) << " triangle(s), degeneracy " << core_numbers(circle).degeneracy;
+    }
+    vector<double> score = betweenness(circle, (int)thread::hardware_concurrency());
+    vector<int> rank(circle.size());
+    iota(rank.begin(), rank.end(), 0);
+    int top = min(3, circle.size());
+    partial_sort(rank.begin(), rank.begin() + top, rank.end(), [&](int a, int b) {
+        return score[a] != score[b] ? score[a] > score[b] : a < b;
+    });
+    cout << "\nHolding it together:";
+    for (int i = 0; i < top; i++)
+    {
+        cout << " " << circle.name(rank[i]) << " (" << score[rank[i]] << ")";
+    }
+    cout << "\n";
+}
+
+// Everyone's core number, most embedded first, and the degeneracy.
+void graph::core_groups()
+{
+    snapshot_store::reader snap = pin();
+    if (!snap->symmetric())
+    {
+        cout << "Cores are only found when friendships are mutual!\n";
+        return;
+    }
+    cores found = core_numbers(*snap);
+    for (int i = snap->size() - 1; i >= 0; i--)
+    {
+        int v = found.order[i];
+        if (snap->present(v))
+        {
+            cout << "\n"
+                 << snap->name(v) << ": in the " << found.core[v] << "-core";
+        }
+    }
+    cout << "\nDegeneracy: " << found.degeneracy << "\n";
+}
+
+void graph::triangles()
+{
+    snapshot_store::reader snap = pin();
+    if (!snap->symmetric())
+    {
+        cout << "Triangles are only counted when friendships are mutual!\n";
+        return;
+    }
+    cout << "\n"
+         << count_triangles(*snap) << " triangle(s) of mutual friends\n";
+}
+
+void graph::display()
+{
+    gnode *temp;
+    lock_guard<mutex> hold(lists);
+    for (int i = 0; i < n; i++)
+    {
+        temp = head[i];
+        if (temp->dead)
+        {
+            continue;
+        }
+        cout << "\nFriends of " << temp->name << "\n";
+        temp = temp->next;
+        while (temp != NULL)
+        {
+            if (!gone(temp) && weighted)
+            {
+                cout << "-> " << temp->name << " (" << temp->weight << ")\n";
+            }
+            else if (!gone(temp))
+            {
+                cout << "-> " << temp->name << "\n";
+            }
+            temp = temp->next;
+        }
+    }
+}
+
+void graph::dfs_r()
+{
+    string v;
+    for (int i = 0; i < n; i++)
+    {
+        visit[i] = 0;
+    }
+    cout << "Please enter name of friend/node you'd like to start with: ";
+    cin >> v;
+    if (!isthere(v))
+    {
+        cout << "Please enter a valid node!\n";
+    }
+    else
+    {
+        lock_guard<mutex> hold(lists);
+        if (replay(where(v), 'r'))
+        {
+            return;
+        }
+        STAT_PHASE(phase, "dfs_r");
+        trail.clear();
+        dfs_r(v);
+        walks.put(where(v), 'r', mutations, trail);
+    }
+}
+
+// Must hold `lists`. Prints a cached traversal from x, if there is one.
+bool graph::replay(int x, char algo)
+{
+    shared_ptr<const vector<int>> order = walks.find(x, algo, mutations);
+    if (!order)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < order->size(); i++)
+    {
+        cout << "\n"
+             << head[(*order)[i]]->name;
+    }
+    return true;
+}
+
+void graph::dfs_r(string v)
+{
+    cout << "\n"
+         << v;
+    int x = where(v);
+    visit[x] = 1;
+    trail.push_back(x);
+    STAT_ADD(visited, 1);
+    gnode *temp = head[x]->next;
+    while (temp != NULL)
+    {
+        string w = temp->name;
+        STAT_ADD(scanned, 1);
+        if (!gone(temp) && !visit[temp->id])
+        {
+            dfs_r(w);
+        }
+        temp = temp->next;
+    }
+}
+
+void graph::dfs_nr()
+{
+    string v;
+    cout << "Please enter name of friend/node you'd like to start with: ";
+    cin >> v;
+    if (!isthere(v))
+    {
+        cout << "Please enter a valid node!\n";
+    }
+    else
+    {
+        for (int i = 0; i < n; i++)
+        {
+            visit[i] = 0;
+        }
+        lock_guard<mutex> hold(lists);
+        int x = where(v);
+        if (replay(x, 'n'))
+        {
+            return;
+        }
+        STAT_PHASE(phase, "dfs_nr");
+        int start = x;
+        stack st;
+        trail.clear();
+        st.push(v);
+        visit[x] = 1;
+
+        do
+        {
+            v = st.pop();
+            cout << "\n"
+                 << v;
+            x = where(v);
+            trail.push_back(x);
+            STAT_ADD(visited, 1);
+            gnode *temp = head[x]->next;
+            while (temp != NULL)
+            {
+                string w = temp->name;
+                int pos = temp->id;
+                STAT_ADD(scanned, 1);
+                if (!gone(temp) && !visit[temp->id])
+                {
+                    st.push(w);
+                    visit[pos] = 1;
+                }
+                temp = temp->next;
+            }
+
+        } while (st.top != -1);
+        walks.put(start, 'n', mutations, trail);
+    }
+}
+
+void graph::bfs()
+{
+    queue kyu;
+    string v;
+    int x;
+    cout << "Please enter name of friend/node you'd like to start with: ";
+    cin >> v;
+    if (!isthere(v))
+    {
+        cout << "Please enter a valid node!\n";
+    }
+    else
+    {
+        for (int i = 0; i < n; i++)
+        {
+            visit[i] = 0;
+        }
+        lock_guard<mutex> hold(lists);
+        x = where(v);
+        if (replay(x, 'b'))
+        {
+            return;
+        }
+        STAT_PHASE(phase, "bfs");
+        int start = x;
+        trail.clear();
+        kyu.enqueue(v);
+        visit[x] = 1;
+        do
+        {
+            v = kyu.dequeue();
+            x = where(v);
+            cout << "\n"
+                 << head[x]->name;
+            trail.push_back(x);
+            STAT_ADD(visited, 1);
+            gnode *temp = head[x]->next;
+            while (temp != NULL)
+            {
+                STAT_ADD(scanned, 1);
+                if (!gone(temp) && visit[temp->id] == 0)
+                {
+                    kyu.enqueue(temp->name);
+                    visit[temp->id] = 1;
+                }
+                temp = temp->next;
+            }
+            if (kyu.rear == kyu.front)
+            {
+                break;
+            }
+        } while (1);
+        walks.put(start, 'b', mutations, trail);
+    }
+}
+
+// Reads "name name [strength [formed]]" friendship lines (# starts a
+// comment) into d, giving each new name the next id. Missing strengths
+// count as 1 if any line has one, and missing times as 0 if any line has
+// one. Returns the number of friendships read.
+long load_edges(istream &in, delta &d)
+{
+    unordered_map<string, int> ids;
+    string line, a, b;
+    long count = 0;
+    bool strengths = false, times = false;
+    while (getline(in, line))
+    {
+        istringstream words(line);
+        float w = 1;
+        long t = 0;
+        if (!(words >> a >> b) || a[0] == '#')
+        {
+            continue;
+        }
+        if (words >> w)
+        {
+            strengths = true;
+            if (words >> t)
+            {
+                times = true;
+            }
+        }
+        d.strength.push_back(w);
+        d.formed.push_back(t);
+        int id[2];
+        string *who[2] = {&a, &b};
+        for (int k = 0; k < 2; k++)
+        {
+            unordered_map<string, int>::iterator it = ids.find(*who[k]);
+            if (it == ids.end())
+            {
+                it = ids.insert(make_pair(*who[k], (int)d.people.size())).first;
+                d.people.push_back(*who[k]);
+            }
+            id[k] = it->second;
+        }
+        d.friendships.push_back(make_pair(id[0], id[1]));
+        count++;
+    }
+    if (!strengths)
+    {
+        d.strength.clear();
+    }
+    if (!times)
+    {
+        d.formed.clear();
+    }
+    return count;
+}
+
+// Parallel bulk load of an edge file in load_edges' format. The file is
+// mapped and cut into one byte range per thread, each starting just past a
+// newline. Every thread parses its own lines into local ids with its own
+// name table, whose keys are views into the mapping, so nothing is copied
+// until the tables are merged. The merge is parallel too: names are split
+// into shards by hash, and each shard's thread walks its names in file
+// order to find where each name first appears. Numbering those first
+// appearances in file order gives everyone the id load_edges would have,
+// and the edges are then renumbered in parallel. Returns the number of
+// friendships read, or -1 if the file can't be opened. Input that can't be
+// mapped (a pipe, say) goes through load_edges instead.
+long load_edge_file(const string &path, delta &d, int threads)
+{
+    threads = max(threads, 1);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    struct stat info;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        ifstream in(path.c_str());
+        return in ? load_edges(in, d) : -1;
+    }
+    madvise(map, info.st_size, MADV_SEQUENTIAL);
+    const char *text = (const char *)map, *end = text + info.st_size;
+
+    struct part
+    {
+        vector<string_view> names;
+        unordered_map<string_view, int> ids;
+        vector<vector<int>> shard;
+        vector<pair<int, int>> edges;
+        vector<float> strength;
+        vector<long> formed;
+        vector<int> global;
+        bool strengths = false;
+        bool times = false;
+    };
+    vector<part> parts(threads);
+    vector<const char *> cut(threads + 1, end);
+    cut[0] = text;
+    for (int t = 1; t < threads; t++)
+    {
+        size_t at = (size_t)info.st_size * t / threads;
+        const char *nl = at == 0 ? NULL : (const char *)memchr(text + at - 1, '\n', info.st_size - at + 1);
+        cut[t] = max(cut[t - 1], at == 0 ? text : nl ? nl + 1 : end);
+    }
+    run_on_threads(threads, [&](int t) {
+        STAT_PHASE(phase, "parse edges");
+        part &mine = parts[t];
+        mine.shard.resize(threads);
+        for (const char *p = cut[t]; p < cut[t + 1];)
+        {
+            const char *eol = (const char *)memchr(p, '\n', cut[t + 1] - p);
+            eol = eol ? eol : cut[t + 1];
+            string_view word[4];
+            int words = 0;
+            for (const char *q = p; q < eol && words < 4;)
+            {
+                while (q < eol && isspace((unsigned char)*q))
+                {
+                    q++;
+                }
+                const char *from = q;
+                while (q < eol && !isspace((unsigned char)*q))
+                {
+                    q++;
+                }
+                if (q > from)
+                {
+                    word[words++] = string_view(from, q - from);
+                }
+            }
+            p = eol + 1;
+            if (words < 2 || word[0][0] == '#')
+            {
+                continue;
+            }
+            // As with `>>`, a strength that doesn't parse reads as 0.
+            float w = 1;
+            long t = 0;
+            if (words >= 3)
+            {
+                char number[64], *stop;
+                size_t len = min(word[2].size(), sizeof(number) - 1);
+                memcpy(number, word[2].data(), len);
+                number[len] = 0;
+                w = strtof(number, &stop);
+                mine.strengths = mine.strengths || stop != number;
+                if (words == 4 && stop != number)
+                {
+                    const char *last = word[3].data() + word[3].size();
+                    mine.times = from_chars(word[3].data(), last, t).ptr != word[3].data() || mine.times;
+                }
+            }
+            int id[2];
+            for (int k = 0; k < 2; k++)
+            {
+                unordered_map<string_view, int>::iterator it = mine.ids.find(word[k]);
+                if (it == mine.ids.end())
+                {
+                    it = mine.ids.insert(make_pair(word[k], (int)mine.names.size())).first;
+                    mine.shard[hash<string_view>()(word[k]) % threads].push_back((int)mine.names.size());
+                    mine.names.push_back(word[k]);
+                }
+                id[k] = it->second;
+            }
+            mine.edges.push_back(make_pair(id[0], id[1]));
+            mine.strength.push_back(w);
+            // Times are only kept from a part's first one on; earlier
+            // friendships read as formed at 0.
+            if (mine.times)
+            {
+                mine.formed.resize(mine.edges.size() - 1);
+                mine.formed.push_back(t);
+            }
+        }
+    });
+
+    // Position of a local name = earlier threads' name counts + its local id,
+    // so positions run in file order; `earliest` maps each to the position
+    // where the same name first appears.
+    vector<long> base(threads + 1, 0);
+    for (int t = 0; t < threads; t++)
+    {
+        unordered_map<string_view, int>().swap(parts[t].ids);
+        base[t + 1] = base[t] + (long)parts[t].names.size();
+    }
+    vector<long> earliest(base[threads]);
+    run_on_threads(threads, [&](int s) {
+        STAT_PHASE(phase, "merge names");
+        unordered_map<string_view, long> seen;
+        for (int t = 0; t < threads; t++)
+        {
+            const vector<int> &mine = parts[t].shard[s];
+            for (size_t i = 0; i < mine.size(); i++)
+            {
+                long at = base[t] + mine[i];
+                unordered_map<string_view, long>::iterator it = seen.find(parts[t].names[mine[i]]);
+                if (it == seen.end())
+                {
+                    it = seen.insert(make_pair(parts[t].names[mine[i]], at)).first;
+                }
+                earliest[at] = it->second;
+            }
+        }
+    });
+    vector<int> id(base[threads]);
+    int people = (int)d.people.size();
+    for (long at = 0; at < base[threads]; at++)
+    {
+        if (earliest[at] == at)
+        {
+            id[at] = people++;
+        }
+    }
+    d.people.resize(people);
+
+    vector<size_t> first(threads + 1, d.friendships.size());
+    bool strengths = false, times = false;
+    for (int t = 0; t < threads; t++)
+    {
+        first[t + 1] = first[t] + parts[t].edges.size();
+        strengths = strengths || parts[t].strengths;
+        times = times || parts[t].times;
+    }
+    d.friendships.resize(first[threads]);
+    d.strength.resize(first[threads]);
+    d.formed.resize(times ? first[threads] : 0);
+    run_on_threads(threads, [&](int t) {
+        part &mine = parts[t];
+        mine.global.resize(mine.names.size());
+        for (size_t k = 0; k < mine.names.size(); k++)
+        {
+            long at = base[t] + (long)k;
+            mine.global[k] = id[earliest[at]];
+            if (earliest[at] == at)
+            {
+                d.people[id[at]] = string(mine.names[k]);
+            }
+        }
+        for (size_t i = 0; i < mine.edges.size(); i++)
+        {
+            d.friendships[first[t] + i] = make_pair(mine.global[mine.edges[i].first], mine.global[mine.edges[i].second]);
+            d.strength[first[t] + i] = mine.strength[i];
+            if (times)
+            {
+                d.formed[first[t] + i] = i < mine.formed.size() ? mine.formed[i] : 0;
+            }
+        }
+    });
+    if (!strengths)
+    {
+        d.strength.clear();
+    }
+    munmap(map, info.st_size);
+    return (long)(first[threads] - first[0]);
+}
+
+volatile sig_atomic_t interrupted = 0;
+
+void interrupt(int)
+{
+    interrupted = 1;
+}
+
+// Answers queries against the latest published snapshot over a Unix domain
+// socket. One request per line, one response line per request, returned in
+// request order even when a client pipelines many requests at once:
+//   BFS <name> | DFS <name> | PATH <a> <b> | MUTUAL <a> <b> | DEGREE <name>
+//   SUGGEST <name> [k] | DIST <a> <b>
+// Responses are "OK ..." or "ERR <reason>". An epoll loop owns the sockets;
+// a pool of workers evaluates the queries.
+class query_server
+{
+    struct client
+    {
+        int fd;
+        bool closed;
+        bool eof;
+        unsigned mask;
+        long issued;
+        long sent;
+        string in;
+        string out;
+        map<long, string> ready;
+        mutex lock;
+    };
+    struct job
+    {
+        shared_ptr<client> from;
+        long seq;
+        string line;
+    };
+
+    snapshot_store &store;
+    const distance_index *index;
+    int listener;
+    int ep;
+    map<int, shared_ptr<client>> clients;
+    deque<job> jobs;
+    mutex jobs_lock;
+    condition_variable jobs_ready;
+    bool stopping;
+    vector<thread> workers;
+
+    string answer(const string &line);
+    void work();
+    void accept_all();
+    void receive(const shared_ptr<client> &c);
+    void flush(client &c);
+    void drop(int fd);
+
+public:
+    query_server(snapshot_store &s, const distance_index *d = NULL) : store(s), index(d), listener(-1), ep(-1), stopping(false) {}
+    bool serve(const string &path, int threads);
+};
+
+string query_server::answer(const string &line)
+{
+    istringstream words(line);
+    string cmd, a, b;
+    words >> cmd >> a >> b;
+    snapshot_store::reader snap = store.pin();
+    int s = snap->id(a), t = snap->id(b);
+    bool pair_query = cmd == "PATH" || cmd == "MUTUAL" || cmd == "DIST";
+    if (cmd != "BFS" && cmd != "DFS" && cmd != "DEGREE" && cmd != "SUGGEST" && !pair_query)
+    {
+        return "ERR unknown command";
+    }
+    if (s < 0 || (pair_query && t < 0))
+    {
+        return "ERR no such person";
+    }
+
+    vector<int> result;
+    if (cmd == "DEGREE")
+    {
+        return "OK " + to_string(snap->degree(s));
+    }
+    else if (cmd == "DIST")
+    {
+        int d;
+        if (index != NULL && index->ready_for(snap->ver()))
+        {
+            d = index->distance(s, t);
+        }
+        else
+        {
+            d = hops(*snap, s)[t];
+        }
+        return d < 0 ? "ERR unreachable" : "OK " + to_string(d);
+    }
+    else if (cmd == "SUGGEST")
+    {
+        thread_local accumulator acc;
+        thread_local long sized_for = -1;
+        if (sized_for != snap->ver())
+        {
+            acc.reset(snap->size());
+            sized_for = snap->ver();
+        }
+        int k = b.empty() ? 10 : atoi(b.c_str());
+        vector<pair<double, int>> best = recommend(*snap, s, k, false, acc);
+        for (size_t i = 0; i < best.size(); i++)
+        {
+            result.push_back(best[i].second);
+        }
+    }
+    else if (cmd == "BFS")
+    {
+        result = bfs_order(*snap, s);
+    }
+    else if (cmd == "DFS")
+    {
+        result = dfs_order(*snap, s);
+    }
+    else if (cmd == "PATH")
+    {
+        result = shortest_path(*snap, s, t);
+        if (result.empty())
+        {
+            return "ERR unreachable";
+        }
+    }
+    else
+    {
+        vector<int> mine;
+        snap->for_each_friend(s, [&](int u) {
+            mine.push_back(u);
+        });
+        size_t k = 0;
+        snap->for_each_friend(t, [&](int u) {
+            while (k < mine.size() && mine[k] < u)
+            {
+                k++;
+            }
+            if (k < mine.size() && mine[k] == u)
+            {
+                result.push_back(u);
+            }
+        });
+    }
+
+    string reply = "OK";
+    for (size_t i = 0; i < result.size(); i++)
+    {
+        reply += " " + snap->name(result[i]);
+    }
+    return reply;
+}
+
+void query_server::work()
+{
+    while (true)
+    {
+        unique_lock<mutex> hold(jobs_lock);
+        jobs_ready.wait(hold, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty())
+        {
+            return;
+        }
+        job next = jobs.front();
+        jobs.pop_front();
+        hold.unlock();
+
+        string reply = answer(next.line);
+        client &c = *next.from;
+        lock_guard<mutex> guard(c.lock);
+        if (c.closed)
+        {
+            continue;
+        }
+        c.ready[next.seq] = reply;
+        while (!c.ready.empty() && c.ready.begin()->first == c.sent)
+        {
+            c.out += c.ready.begin()->second;
+            c.out += '\n';
+            c.ready.erase(c.ready.begin());
+            c.sent++;
+        }
+        flush(c);
+    }
+}
+
+// Caller holds c.lock. Writes as much as the socket takes and arms EPOLLOUT
+// for the rest. Once a client has stopped sending and every answer is out,
+// its write side is shut so it sees end of stream.
+void query_server::flush(client &c)
+{
+    while (!c.out.empty())
+    {
+        ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            return;
+        }
+        c.out.erase(0, n);
+    }
+    unsigned want = (c.eof ? 0u : unsigned(EPOLLIN)) | (c.out.empty() ? 0u : unsigned(EPOLLOUT));
+    if (want != c.mask)
+    {
+        epoll_event ev;
+        ev.events = want;
+        ev.data.fd = c.fd;
+        epoll_ctl(ep, EPOLL_CTL_MOD, c.fd, &ev);
+        c.mask = want;
+    }
+    if (c.eof && c.out.empty() && c.sent == c.issued)
+    {
+        shutdown(c.fd, SHUT_WR);
+    }
+}
+
+void query_server::accept_all()
+{
+    int fd;
+    while ((fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        shared_ptr<client> c = make_shared<client>();
+        c->fd = fd;
+        c->closed = false;
+        c->eof = false;
+        c->mask = EPOLLIN;
+        c->issued = 0;
+        c->sent = 0;
+        clients[fd] = c;
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void query_server::receive(const shared_ptr<client> &c)
+{
+    char buf[65536];
+    vector<job> batch;
+    bool ended = false, failed = false;
+    while (true)
+    {
+        ssize_t n = read(c->fd, buf, sizeof(buf));
+        if (n > 0)
+        {
+            c->in.append(buf, n);
+            continue;
+        }
+        ended = n == 0;
+        failed = n < 0 && errno != EAGAIN && errno != EWOULDBLOCK;
+        break;
+    }
+
+    size_t start = 0, end;
+    while ((end = c->in.find('\n', start)) != string::npos)
+    {
+        job j;
+        j.from = c;
+        j.seq = c->issued++;
+        j.line = c->in.substr(start, end - start);
+        batch.push_back(j);
+        start = end + 1;
+    }
+    c->in.erase(0, start);
+
+    if (!batch.empty())
+    {
+        lock_guard<mutex> hold(jobs_lock);
+        jobs.insert(jobs.end(), batch.begin(), batch.end());
+    }
+    jobs_ready.notify_all();
+    if (failed)
+    {
+        drop(c->fd);
+        return;
+    }
+    if (ended)
+    {
+        unique_lock<mutex> hold(c->lock);
+        bool done = c->eof && c->out.empty() && c->sent == c->issued;
+        c->eof = true;
+        flush(*c);
+        hold.unlock();
+        if (done)
+        {
+            drop(c->fd);
+        }
+    }
+}
+
+void query_server::drop(int fd)
+{
+    shared_ptr<client> c = clients[fd];
+    clients.erase(fd);
+    lock_guard<mutex> hold(c->lock);
+    c->closed = true;
+    epoll_ctl(ep, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+}
+
+bool query_server::serve(const string &path, int threads)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        cout << "Socket path is too long!\n";
+        return false;
+    }
+    strcpy(addr.sun_path, path.c_str());
+    unlink(path.c_str());
+
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0 || bind(listener, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listener, 512) < 0)
+    {
+        cout << "Can't listen on " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    ep = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = listener;
+    epoll_ctl(ep, EPOLL_CTL_ADD, listener, &ev);
+
+    signal(SIGINT, interrupt);
+    signal(SIGTERM, interrupt);
+    for (int i = 0; i < threads; i++)
+    {
+        workers.push_back(thread(&query_server::work, this));
+    }
+
+    epoll_event events[256];
+    while (!interrupted)
+    {
+        int n = epoll_wait(ep, events, 256, 200);
+        for (int i = 0; i < n; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == listener)
+            {
+                accept_all();
+                continue;
+            }
+            map<int, shared_ptr<client>>::iterator it = clients.find(fd);
+            if (it == clients.end())
+            {
+                continue;
+            }
+            shared_ptr<client> c = it->second;
+            if (events[i].events & EPOLLOUT)
+            {
+                lock_guard<mutex> hold(c->lock);
+                flush(*c);
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                receive(c);
+            }
+        }
+    }
+
+    {
+        lock_guard<mutex> hold(jobs_lock);
+        stopping = true;
+    }
+    jobs_ready.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+    while (!clients.empty())
+    {
+        drop(clients.begin()->first);
+    }
+    close(ep);
+    close(listener);
+    unlink(path.c_str());
+    return true;
+}
+
+// The arguments of one command line mode: its words in the order given, and
+// its --flags and --key=value options wherever they sit among them.
+class mode_args
+{
+    vector<const char *> words;
+    vector<const char *> flags;
+
+public:
+    mode_args(int argc, char **argv, int from)
+    {
+        for (int i = from; i < argc; i++)
+        {
+            (strncmp(argv[i], "--", 2) == 0 ? flags : words).push_back(argv[i]);
+        }
+    }
+    size_t count() const
+    {
+        return words.size();
+    }
+    const char *word(size_t i) const
+    {
+        return words[i];
+    }
+    long number(size_t i, long otherwise) const
+    {
+        return i < words.size() ? atol(words[i]) : otherwise;
+    }
+    double real(size_t i, double otherwise) const
+    {
+        return i < words.size() ? atof(words[i]) : otherwise;
+    }
+    // Word i as a thread count, every core when it isn't given.
+    int threads(size_t i) const
+    {
+        return (int)number(i, (long)thread::hardware_concurrency());
+    }
+    bool has(const char *flag) const
+    {
+        for (size_t i = 0; i < flags.size(); i++)
+        {
+            if (strcmp(flags[i], flag) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    // What follows key (say "--log=") in the last option starting with it.
+    const char *value(const char *key, const char *otherwise) const
+    {
+        size_t k = strlen(key);
+        for (size_t i = flags.size(); i-- > 0;)
+        {
+            if (strncmp(flags[i], key, k) == 0)
+            {
+                return flags[i] + k;
+            }
+        }
+        return otherwise;
+    }
+    // False, having said which, if an option isn't one of `known`; those
+    // ending in '=' take a value.
+    bool only(initializer_list<const char *> known) const
+    {
+        for (size_t i = 0; i < flags.size(); i++)
+        {
+            bool ok = false;
+            for (const char *k : known)
+            {
+                size_t n = strlen(k);
+                ok = ok || (k[n - 1] == '=' ? strncmp(flags[i], k, n) == 0 : strcmp(flags[i], k) == 0);
+            }
+            if (!ok)
+            {
+                cout << "Unknown option: " << flags[i] << "\n";
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Reads an edge file into store as its first version, or says it can't.
+bool load_snapshot(snapshot_store &store, const char *path, int threads)
+{
+    delta d;
+    if (load_edge_file(path, d, threads) < 0)
+    {
+        cout << "Can't open " << path << "\n";
+        return false;
+    }
+    store.publish(d, threads);
+    return true;
+}
+
+// graph --serve <socket> <edge file> [threads] [--undirected] [--compressed]
+//       [--index=<file>]
+// With --index the distance index is loaded from <file> if it matches the
+// graph, and otherwise built and saved there.
+int serve_main(const mode_args &args)
+{
+    snapshot_store store(args.has("--undirected"), args.has("--compressed"));
+    string index_file = args.value("--index=", "");
+    int threads = args.threads(2);
+    if (!args.only({"--undirected", "--compressed", "--index="}) || !load_snapshot(store, args.word(1), threads))
+    {
+        return 1;
+    }
+    {
+        snapshot_store::reader snap = store.pin();
+        cout << "Serving " << snap->size() << " people and " << snap->edges() << " friendships on " << args.word(0) << "\n";
+        snap->memory().print("Memory:");
+    }
+    distance_index index;
+    if (!index_file.empty())
+    {
+        snapshot_store::reader snap = store.pin();
+        if (!index.load(index_file, distance_index::fingerprint(*snap), snap->ver()))
+        {
+            index.build(*snap, snap->ver());
+            index.save(index_file);
+        }
+        cout << "Distance index: " << index.entries() << " label entries\n";
+    }
+    query_server server(store, index_file.empty() ? NULL : &index);
+    bool ok = server.serve(args.word(0), max(threads, 1));
+#ifdef GRAPH_STATS
+    report_stats(string(args.word(0)) + ".trace.json");
+#endif
+    return ok ? 0 : 1;
+}
+
+// Whether hops, dijkstra and the friends above each person agree between s
+// and the static_graph<D, W, Id, S> copied from from (s itself, or a
+// directed snapshot of the same friendships when s is mutual). Without
+// weights, dijkstra's distances must be the hop counts.
+template <class D, class W, class Id, template <class, class> class S>
+bool static_graph_agrees(const snapshot &from, const snapshot &s)
+{
+    static_graph<D, W, Id, S> g(from);
+    for (int v = 0; v < s.size(); v++)
+    {
+        vector<int> near = hops(s, v), mine(g.size(), -1), theirs(s.size(), -1);
+        if (hops(g, v) != near)
+        {
+            return false;
+        }
+        vector<int> above, want_above;
+        g.for_each_upper(v, [&](int u) {
+            above.push_back(u);
+        });
+        s.for_each_friend(v, [&](int u) {
+            if (u > v)
+            {
+                want_above.push_back(u);
+            }
+        });
+        sort(want_above.begin(), want_above.end());
+        if (above != want_above)
+        {
+            return false;
+        }
+        vector<double> want = dijkstra(s, v, theirs), got = dijkstra(g, v, mine);
+        for (int u = 0; u < s.size() && !g.weighted(); u++)
+        {
+            want[u] = near[u] < 0 ? numeric_limits<double>::infinity() : near[u];
+        }
+        if (got != want)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// static_graph_agrees for every storage layout.
+template <class D, class W, class Id>
+bool static_layouts_agree(const snapshot &from, const snapshot &s)
+{
+    return static_graph_agrees<D, W, Id, list_storage>(from, s) && static_graph_agrees<D, W, Id, csr_storage>(from, s) && static_graph_agrees<D, W, Id, packed_storage>(from, s);
+}
+
+// graph --self-check runs the kernels on small fixed graphs and reports
+// any result that is off. Returns the number of failed checks.
+int self_check()
+{
+    int failed = 0;
+    auto check = [&](bool ok, const char *what) {
+        cout << (ok ? "ok      " : "FAILED  ") << what << "\n";
+        failed += !ok;
+    };
+    auto load = [](snapshot_store &store, const char *text) {
+        istringstream in(text);
+        delta d;
+        load_edges(in, d);
+        store.publish(d);
+    };
+
+    // a - b - c triangle with d hanging off c. Walks a -> x -> y come back
+    // to a less often as the return parameter p grows.
+    {
+        snapshot_store store(true);
+        load(store, "a b\na c\nb c\nc d\n");
+        snapshot_store::reader snap = store.pin();
+        walker paths(*snap, false, 1);
+        vector<int> from(1, snap->id("a"));
+        auto back = [&](double p, double q) {
+            walk_buffer found = paths.walks(from, 20000, 3, p, q, 7, 1);
+            long count = 0;
+            for (long w = 0; w < found.count; w++)
+            {
+                count += found.walk(w)[2] == found.walk(w)[0];
+            }
+            return (double)count / found.count;
+        };
+        double plain = back(1, 1), wary = back(4, 4), eager = back(0.25, 1);
+        check(wary < plain * 0.6, "node2vec p > 1 makes return steps rarer");
+        check(eager > plain * 1.4, "node2vec p < 1 makes return steps likelier");
+    }
+
+    // More readers than one block of epoch slots can pin at once, and the
+    // version they hold is freed when the last of them lets go rather than
+    // at the next publish.
+    {
+        snapshot_store store(true);
+        load(store, "a b\n");
+        vector<snapshot_store::reader> held;
+        for (int i = 0; i < 100; i++)
+        {
+            held.push_back(store.pin());
+        }
+        load(store, "c d\n");
+        bool kept = store.retained() == 1 && held.front()->ver() == held.back()->ver() && held.back()->ver() != store.pin()->ver();
+        held.clear();
+        check(kept && store.retained() == 0, "100 readers pin at once and their version is freed on release");
+    }
+
+    // Varints round-trip across the one/two byte boundary and at full
+    // width, zigzag maps small magnitudes of either sign to small codes,
+    // and a packed snapshot reads back exactly the lists of a plain one.
+    {
+        unsigned long plain[] = {0, 1, 127, 128, 16383, 16384, (unsigned long)INT_MAX, UINT_MAX, ULONG_MAX};
+        vector<unsigned char> bytes;
+        for (unsigned long x : plain)
+        {
+            put_varint(bytes, x);
+        }
+        const unsigned char *p = bytes.data();
+        bool round = true;
+        for (unsigned long x : plain)
+        {
+            round = round && get_varint(p) == x;
+        }
+        vector<unsigned char> one, two;
+        put_varint(one, 127);
+        put_varint(two, 128);
+        check(round && p == bytes.data() + bytes.size() && one.size() == 1 && two.size() == 2, "varints round-trip from 0 to full width");
+        long signs[] = {0, -1, 1, -64, 64, INT_MAX, -(long)INT_MAX, INT_MIN, LONG_MAX, LONG_MIN};
+        bool zig = zigzag(0) == 0 && zigzag(-1) == 1 && zigzag(1) == 2 && zigzag(-64) == 127 && zigzag(64) == 128;
+        for (long x : signs)
+        {
+            zig = zig && unzigzag(zigzag(x)) == x;
+        }
+        check(zig, "zigzag round-trips both signs, extremes included");
+
+        // Hubs befriend people hundreds of ids away, so gaps need several
+        // bytes, and most lists start below their own id.
+        ostringstream text;
+        unsigned long x = 12345;
+        for (int i = 0; i < 3000; i++)
+        {
+            x = x * 6364136223846793005ul + 1442695040888963407ul;
+            int a = (int)((x >> 33) % 800), b = (int)(i % 7 == 0 ? (x >> 20) % 8 : (x >> 45) % 800);
+            text << "p" << a << " p" << b << "\n";
+        }
+        bool alike = true;
+        for (int mutual = 0; mutual < 2; mutual++)
+        {
+            snapshot_store wide(mutual, false), tight(mutual, true);
+            load(wide, text.str().c_str());
+            load(tight, text.str().c_str());
+            snapshot_store::reader w = wide.pin(), t = tight.pin();
+            alike = alike && t->compressed() && w->size() == t->size() && w->edges() == t->edges();
+            for (int v = 0; alike && v < w->size(); v++)
+            {
+                vector<int> ws, ts, wu, tu;
+                w->for_each_friend(v, [&](int u) {
+                    ws.push_back(u);
+                });
+                t->for_each_friend(v, [&](int u) {
+                    ts.push_back(u);
+                });
+                if (mutual)
+                {
+                    w->for_each_upper(v, [&](int u) {
+                        wu.push_back(u);
+                    });
+                    t->for_each_upper(v, [&](int u) {
+                        tu.push_back(u);
+                    });
+                }
+                alike = ws == ts && wu == tu && w->degree(v) == t->degree(v);
+            }
+        }
+        check(alike, "packed snapshots list the same friends as plain ones");
+    }
+
+    // A giant ring with chords, a cycle with cycles nested inside it, a
+    // two-person loop, a singleton on either side of the giant and a cycle
+    // on its own. Tarjan and forward-backward must both match mutual
+    // reachability, number components so every friendship runs forwards
+    // and list exactly the friendships between components as the DAG, and
+    // split people the same way.
+    {
+        ostringstream text;
+        for (int i = 0; i < 200; i++)
+        {
+            text << "p" << i << " p" << (i + 1) % 200 << "\np" << i << " p" << i * 7 % 200 << "\n";
+        }
+        for (int i = 0; i < 10; i++)
+        {
+            text << "p" << 200 + i << " p" << 200 + (i + 1) % 10 << "\n";
+        }
+        for (int i = 0; i < 6; i++)
+        {
+            text << "p" << 220 + i << " p" << 220 + (i + 1) % 6 << "\n";
+        }
+        text << "p200 p205\np205 p200\np203 p201\np222 p220\np17 p200\np204 p210\np210 p211\np211 p210\np211 p212\np213 p17\n";
+        snapshot_store store;
+        load(store, text.str().c_str());
+        snapshot_store::reader snap = store.pin();
+        int n = snap->size();
+        vector<vector<int>> reach(n);
+        for (int v = 0; v < n; v++)
+        {
+            reach[v] = hops(*snap, v);
+        }
+        auto sound = [&](const strong_components &c) {
+            vector<pair<int, int>> arcs;
+            bool ok = (int)c.of.size() == n && (int)c.dag_at.size() == c.count() + 1;
+            for (int v = 0; ok && v < n; v++)
+            {
+                for (int u = 0; ok && u < n; u++)
+                {
+                    ok = (c.of[u] == c.of[v]) == (reach[v][u] >= 0 && reach[u][v] >= 0);
+                }
+                snap->for_each_friend(v, [&](int u) {
+                    ok = ok && c.of[v] <= c.of[u];
+                    if (c.of[v] != c.of[u])
+                    {
+                        arcs.push_back(make_pair(c.of[v], c.of[u]));
+                    }
+                });
+            }
+            sort(arcs.begin(), arcs.end());
+            arcs.erase(unique(arcs.begin(), arcs.end()), arcs.end());
+            vector<pair<int, int>> dag;
+            for (int k = 0; ok && k < c.count(); k++)
+            {
+                for (int e = c.dag_at[k]; e < c.dag_at[k + 1]; e++)
+                {
+                    dag.push_back(make_pair(k, c.dag[e]));
+                }
+            }
+            return ok && dag == arcs && c.size[c.of[snap->id("p0")]] == 200 && c.size[c.of[snap->id("p200")]] == 10;
+        };
+        strong_components one = strongly_connected(*snap), many = strongly_connected(*snap, 3);
+        bool same = one.count() == many.count();
+        vector<int> as(one.count(), -1);
+        for (int v = 0; same && v < n; v++)
         {
-            cout << "\nEnter friend of " << head[i]->name << ": \n";
-            cin >> fren;
-            if (fren == head[i]->name)
+            if (as[one.of[v]] < 0)
             {
-                cout << "They can't be their own friend!! Try again\n";
+                as[one.of[v]] = many.of[v];
             }
-            else if (!isthere(fren))
+            same = as[one.of[v]] == many.of[v];
+        }
+        check(sound(one), "Tarjan finds the strong components in topological order");
+        check(sound(many), "forward-backward finds the strong components in topological order");
+        check(same, "Tarjan and forward-backward split people the same way");
+    }
+
+    // Every static_graph configuration answers like the snapshot it was
+    // copied from, directed ones from a directed snapshot and undirected
+    // ones from a mutual one.
+    {
+        const char *text = "a b 2\nb c 1.5\na c 5\nc d 1\nd a 3\ne f 1\nb d 0.5\n";
+        snapshot_store one_way(false), mutual(true);
+        load(one_way, text);
+        load(mutual, text);
+        snapshot_store::reader x = one_way.pin(), y = mutual.pin();
+        check(static_layouts_agree<directed, no_weight, uint32_t>(*x, *x) && static_layouts_agree<directed, no_weight, uint64_t>(*x, *x), "directed unweighted static_graph layouts match the snapshot");
+        check(static_layouts_agree<directed, float, uint32_t>(*x, *x) && static_layouts_agree<directed, float, uint64_t>(*x, *x), "directed weighted static_graph layouts match the snapshot");
+        check(static_layouts_agree<undirected, no_weight, uint32_t>(*y, *y) && static_layouts_agree<undirected, no_weight, uint64_t>(*y, *y), "undirected unweighted static_graph layouts match the snapshot");
+        check(static_layouts_agree<undirected, float, uint32_t>(*y, *y) && static_layouts_agree<undirected, float, uint64_t>(*y, *y), "undirected weighted static_graph layouts match the snapshot");
+        check(static_layouts_agree<undirected, float, uint32_t>(*x, *y) && static_layouts_agree<undirected, no_weight, uint64_t>(*x, *y), "undirected static_graph from a directed snapshot adds reverse friendships");
+    }
+
+    // A log checkpointed partway, written on after, then cut off mid-crash
+    // with a record whose checksum is wrong and one torn in half. Recovery
+    // replays what was durable into the pre-crash graph, cuts the log where
+    // the damage starts and appends after it.
+    {
+        char path[] = "/tmp/graph-check-XXXXXX";
+        int fd = mkstemp(path);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        string snap = string(path) + ".snap";
+        delta first, second, third, fourth, state;
+        first.people = {"a", "b", "c", "d"};
+        first.friendships = {make_pair(0, 1), make_pair(1, 2)};
+        first.strength = {2, 3};
+        first.formed = {10, 20};
+        second.friendships = {make_pair(2, 3)};
+        second.strength = {0.5f};
+        second.formed = {30};
+        third.people = {"e"};
+        third.friendships = {make_pair(3, 4)};
+        third.strength = {4};
+        third.formed = {40};
+        fourth.unfriended = {make_pair(0, 1)};
+        state = first;
+        state.friendships.push_back(second.friendships[0]);
+        state.strength.push_back(second.strength[0]);
+        state.formed.push_back(second.formed[0]);
+        snapshot_store before(true);
+        before.publish(first);
+        before.publish(second);
+        before.publish(third);
+        before.publish(fourth);
+        long intact = -1;
+        {
+            write_ahead_log log;
+            delta none;
+            vector<delta> nothing;
+            bool ok = fd >= 0 && log.open(path, none, nothing) && log.wait(log.append(first)) && log.wait(log.append(second));
+            ok = ok && log.checkpoint(state, true, true) && log.wait(log.append(third)) && log.wait(log.append(fourth));
+            intact = ok ? log.size() : -1;
+            log.abandon();
+        }
+        {
+            ofstream damage(path, ios::binary | ios::app);
+            unsigned len = 12, crc = 0;
+            long seq = 99;
+            damage.write((const char *)&len, sizeof(len)).write((const char *)&crc, sizeof(crc)).write((const char *)&seq, sizeof(seq)).write("\0\0\0\0", 4);
+            len = 100;
+            damage.write((const char *)&len, sizeof(len)).write("torn", 4);
+        }
+        // Same people, presence and strengths on every friendship.
+        auto same = [](const snapshot &x, const snapshot &y) {
+            bool ok = x.size() == y.size() && x.edges() == y.edges();
+            for (int v = 0; ok && v < x.size(); v++)
             {
-                cout << "No such person exists!!\n";
+                vector<pair<int, float>> xs, ys;
+                x.for_each_edge(v, [&](int u, float w) {
+                    xs.push_back(make_pair(u, w));
+                });
+                y.for_each_edge(v, [&](int u, float w) {
+                    ys.push_back(make_pair(u, w));
+                });
+                ok = x.name(v) == y.name(v) && x.present(v) == y.present(v) && xs == ys;
             }
-            else
+            return ok;
+        };
+        bool mutual = false, strengths = false, replayed = false, cut = false, reused = false;
+        {
+            write_ahead_log log;
+            delta saved;
+            vector<delta> tail;
+            snapshot_store after(true);
+            replayed = intact > 0 && write_ahead_log::flags(path, mutual, strengths) && log.open(path, saved, tail) && tail.size() == 2;
+            if (replayed)
             {
-                gnode *curr = new gnode;
-                curr->name = fren;
-                curr->id = where(fren);
-                curr->next = NULL;
-                temp->next = curr;
-                temp = temp->next;
+                after.publish(saved);
+                for (size_t i = 0; i < tail.size(); i++)
+                {
+                    after.publish(tail[i]);
+                }
+                replayed = same(*before.pin(), *after.pin());
             }
-            cout << "Are there more adjacent nodes? (y/n): ";
-            cin >> ch;
-
-        } while (ch == 'y');
+            struct stat info;
+            cut = replayed && stat(path, &info) == 0 && info.st_size == intact;
+            delta fifth;
+            fifth.friendships = {make_pair(0, 2)};
+            fifth.strength = {1};
+            fifth.formed = {50};
+            cut = cut && log.wait(log.append(fifth));
+            log.abandon();
+        }
+        {
+            write_ahead_log log;
+            delta saved;
+            vector<delta> tail;
+            reused = cut && log.open(path, saved, tail) && tail.size() == 3 && tail[2].friendships.size() == 1;
+            log.abandon();
+        }
+        check(mutual && strengths && replayed, "write-ahead log replays checkpoint and tail into the pre-crash graph");
+        check(cut && reused, "write-ahead log cuts a corrupt or torn tail and appends after it");
+        unlink(path);
+        unlink(snap.c_str());
     }
-}
 
-void graph::display()
-{
-    gnode *temp;
-    for (int i = 0; i < n; i++)
+    // A saved distance index must not load for a graph rewired to keep
+    // every degree (self-loops only fix the id order).
     {
-        temp = head[i];
-        cout << "\nFriends of " << temp->name << "\n";
-        temp = temp->next;
-        while (temp != NULL)
+        snapshot_store before(true), after(true);
+        load(before, "a a\nb b\nc c\nd d\na b\nc d\n");
+        load(after, "a a\nb b\nc c\nd d\na c\nb d\n");
+        snapshot_store::reader x = before.pin(), y = after.pin();
+        char path[] = "/tmp/graph-check-XXXXXX";
+        int fd = mkstemp(path);
+        if (fd >= 0)
         {
-            cout << "-> " << temp->name << "\n";
-            temp = temp->next;
+            close(fd);
         }
+        distance_index index;
+        index.build(*x, x->ver());
+        bool saved = fd >= 0 && index.save(path);
+        distance_index same, rewired;
+        check(saved && same.load(path, distance_index::fingerprint(*x), x->ver()) && same.distance(0, 1) == 1, "distance index reloads for its own graph");
+        check(saved && !rewired.load(path, distance_index::fingerprint(*y), y->ver()), "distance index is rejected for a rewired graph");
+        // The same file cut short, claiming a huge first array, and naming
+        // a hub past the last person: each must fail to load, not allocate
+        // or read out of bounds, and leave the loaded index alone.
+        ifstream in(path, ios::binary);
+        string file((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        size_t head = 4 + sizeof(unsigned long) + sizeof(int) + 1, hubs = head + sizeof(size_t) + (x->size() + 1) * sizeof(long) + sizeof(size_t);
+        auto rejected = [&](string broken) {
+            ofstream(path, ios::binary | ios::trunc).write(broken.data(), broken.size());
+            return !same.load(path, distance_index::fingerprint(*x), x->ver()) && same.distance(0, 1) == 1;
+        };
+        string huge = file, stray = file;
+        memset(&huge[head], 0x7f, sizeof(size_t));
+        int past = x->size() + 5;
+        memcpy(&stray[hubs], &past, sizeof(past));
+        check(saved && file.size() > hubs + sizeof(int) && rejected(file.substr(0, file.size() / 2)) && rejected(huge) && rejected(stray), "distance index rejects a truncated or corrupt file");
+        unlink(path);
     }
+    return failed;
 }
 
-void graph::dfs_r()
+int main(int argc, char **argv)
 {
-    string v;
-    for (int i = 0; i < n; i++)
+    if (argc == 2 && strcmp(argv[1], "--self-check") == 0)
     {
-        visit[i] = 0;
+        return self_check() == 0 ? 0 : 1;
     }
-    cout << "Please enter name of friend/node you'd like to start with: ";
-    cin >> v;
-    if (!isthere(v))
+    mode_args args(argc, argv, 2);
+    if (argc >= 2 && strcmp(argv[1], "--serve") == 0 && args.count() >= 2)
     {
-        cout << "Please enter a valid node!\n";
+        return serve_main(args);
     }
-    else
+    // graph --communities <edge file> [seed] [threads] [--undirected]
+    // prints "name community size" for everyone. Given a seed it runs on one
+    // thread unless told otherwise, so the same seed always gives the same
+    // communities; more threads are faster but no longer repeatable.
+    if (argc >= 2 && strcmp(argv[1], "--communities") == 0 && args.count() >= 1)
     {
-        dfs_r(v);
+        snapshot_store store(args.has("--undirected"));
+        int threads = args.count() > 1 ? (int)args.number(2, 1) : args.threads(2);
+        if (!args.only({"--undirected"}) || !load_snapshot(store, args.word(0), threads))
+        {
+            return 1;
+        }
+        snapshot_store::reader snap = store.pin();
+        communities found = propagate_labels(*snap, (unsigned)args.number(1, 1), threads);
+        for (int v = 0; v < snap->size(); v++)
+        {
+            cout << snap->name(v) << " " << found.of[v] << " " << found.size[found.of[v]] << "\n";
+        }
+        return 0;
     }
-}
-
-void graph::dfs_r(string v)
-{
-    cout << "\n"
-         << v;
-    int x = where(v);
-    visit[x] = 1;
-    gnode *temp = head[x]->next;
-    while (temp != NULL)
+    // graph --export <dot|graphml> <edge file> [--undirected]
+    //     [--ego=<name>:<hops> | --group=<name>] streams the graph, or part
+    //     of it, to standard output.
+    if (argc >= 2 && strcmp(argv[1], "--export") == 0 && args.count() >= 2)
     {
-        string w = temp->name;
-        if (!visit[temp->id])
+        snapshot_store store(args.has("--undirected"));
+        if (!args.only({"--undirected", "--ego=", "--group="}) || !load_snapshot(store, args.word(1), (int)thread::hardware_concurrency()))
         {
-            dfs_r(w);
+            return 1;
         }
-        temp = temp->next;
+        snapshot_store::reader snap = store.pin();
+        string ego = args.value("--ego=", ""), group = args.value("--group=", "");
+        vector<char> keep;
+        size_t colon = ego.rfind(':');
+        string who = colon == string::npos ? ego.empty() ? group : ego : ego.substr(0, colon);
+        if (!who.empty())
+        {
+            int v = snap->id(who);
+            if (v < 0)
+            {
+                cerr << "No such person: " << who << "\n";
+                return 1;
+            }
+            keep = ego.empty() ? group_mask(*snap, v) : ego_mask(*snap, v, colon == string::npos ? 1 : atoi(ego.c_str() + colon + 1));
+        }
+        buffered_sink out(1);
+        if (strcmp(args.word(0), "graphml") == 0)
+        {
+            export_graphml(*snap, out, keep);
+        }
+        else
+        {
+            export_dot(*snap, out, keep);
+        }
+        return out.flush() ? 0 : 1;
     }
-}
-
-void graph::dfs_nr()
-{
-    string v;
-    cout << "Please enter name of friend/node you'd like to start with: ";
-    cin >> v;
-    if (!isthere(v))
+    // graph --anf <edge file> <hops> [threads] [--undirected] prints "name
+    // reach" for everyone, reach being the estimated number of others within
+    // <hops>, then the effective diameter.
+    if (argc >= 2 && strcmp(argv[1], "--anf") == 0 && args.count() >= 2)
     {
-        cout << "Please enter a valid node!\n";
+        snapshot_store store(args.has("--undirected"));
+        int threads = args.threads(2);
+        if (!args.only({"--undirected"}) || !load_snapshot(store, args.word(0), threads))
+        {
+            return 1;
+        }
+        snapshot_store::reader snap = store.pin();
+        neighbourhood found = hyper_anf(*snap, (int)args.number(1, 0), threads);
+        for (int v = 0; v < snap->size(); v++)
+        {
+            cout << snap->name(v) << " " << (long)(found.reach[v] - 0.5f) << "\n";
+        }
+        cout << "effective diameter " << found.effective_diameter << "\n";
+        return 0;
     }
-    else
+    // graph --walks <edge file> <out file> <walks per person> <length> [p q]
+    // [threads] [--undirected] [--weighted] writes a walk_buffer. Walks are
+    // uniform unless --weighted, which steps by the file's strengths.
+    if (argc >= 2 && strcmp(argv[1], "--walks") == 0 && args.count() >= 4)
     {
-        for (int i = 0; i < n; i++)
+        double p = args.count() > 5 ? args.real(4, 1) : 1, q = args.count() > 5 ? args.real(5, 1) : 1;
+        int threads = args.threads(6);
+        if (!(p > 0) || !(q > 0))
         {
-            visit[i] = 0;
+            cout << "p and q must be positive\n";
+            return 1;
         }
-        stack st;
-        int x = where(v);
-        st.push(v);
-        visit[x] = 1;
-
-        do
+        snapshot_store store(args.has("--undirected"));
+        if (!args.only({"--undirected", "--weighted"}) || !load_snapshot(store, args.word(0), threads))
         {
-            v = st.pop();
-            cout << "\n"
-                 << v;
-            x = where(v);
-            gnode *temp = head[x]->next;
-            while (temp != NULL)
+            return 1;
+        }
+        snapshot_store::reader snap = store.pin();
+        walker paths(*snap, args.has("--weighted") && snap->weighted(), threads);
+        walk_buffer found = paths.walks(vector<int>(), (int)args.number(2, 0), (int)args.number(3, 0), p, q, 1, threads);
+        return found.save(args.word(1)) ? 0 : 1;
+    }
+    // graph --window <edge file> <name> <from> <to> [--undirected]
+    // [--in-order] prints "name hops" for everyone reached from <name> over
+    // friendships formed within [from, to] (the file's fourth column), or
+    // with --in-order "name time", the earliest time-respecting arrival.
+    if (argc >= 2 && strcmp(argv[1], "--window") == 0 && args.count() >= 4)
+    {
+        bool in_order = args.has("--in-order");
+        snapshot_store store(args.has("--undirected"));
+        if (!args.only({"--undirected", "--in-order"}) || !load_snapshot(store, args.word(0), (int)thread::hardware_concurrency()))
+        {
+            return 1;
+        }
+        snapshot_store::reader snap = store.pin();
+        int v = snap->id(args.word(1));
+        if (v < 0)
+        {
+            cout << "No such person: " << args.word(1) << "\n";
+            return 1;
+        }
+        long from = args.number(2, 0), to = args.number(3, 0);
+        vector<int> dist;
+        vector<long> first;
+        if (in_order)
+        {
+            first = earliest_arrival(*snap, v, from, to);
+        }
+        else
+        {
+            dist = window_hops(*snap, v, from, to);
+        }
+        for (int u = 0; u < snap->size(); u++)
+        {
+            if (in_order ? first[u] != LONG_MAX : dist[u] >= 0)
             {
-                string w = temp->name;
-                int pos = temp->id;
-                if (!visit[temp->id])
-                {
-                    st.push(w);
-                    visit[pos] = 1;
-                }
-                temp = temp->next;
+                cout << snap->name(u) << " " << (in_order ? first[u] : (long)dist[u]) << "\n";
             }
-
-        } while (st.top != -1);
+        }
+        return 0;
     }
-}
-
-void graph::bfs()
-{
-    queue kyu;
-    string v;
-    int x;
-    cout << "Please enter name of friend/node you'd like to start with: ";
-    cin >> v;
-    if (!isthere(v))
+    // graph --similar <edge file> <threshold> [hashes] [threads]
+    // [--undirected] prints "name name similarity" for pairs whose friend
+    // sets are estimated at least <threshold> alike, from MinHash and LSH.
+    if (argc >= 2 && strcmp(argv[1], "--similar") == 0 && args.count() >= 2)
     {
-        cout << "Please enter a valid node!\n";
+        double threshold = args.real(1, 0);
+        int hashes = max((int)args.number(2, 64), 1);
+        int threads = args.threads(3);
+        snapshot_store store(args.has("--undirected"));
+        if (!args.only({"--undirected"}) || !load_snapshot(store, args.word(0), threads))
+        {
+            return 1;
+        }
+        snapshot_store::reader snap = store.pin();
+        int rows = minhash::rows_for(threshold, hashes);
+        minhash sketch(*snap, hashes / rows, rows, threads);
+        vector<pair<int, int>> found = sketch.pairs(threshold, threads);
+        buffered_sink out(1);
+        for (size_t i = 0; i < found.size(); i++)
+        {
+            out << snap->name(found[i].first) << ' ' << snap->name(found[i].second) << ' ' << (float)sketch.similarity(found[i].first, found[i].second) << '\n';
+        }
+        return out.flush() ? 0 : 1;
     }
-    else
+    // graph --cores <edge file> [threads] prints "name core" in degeneracy
+    // order, friendships taken as mutual, then the degeneracy.
+    if (argc >= 2 && strcmp(argv[1], "--cores") == 0 && args.count() >= 1)
     {
-        for (int i = 0; i < n; i++)
+        int threads = args.threads(1);
+        snapshot_store store(true);
+        if (!args.only({}) || !load_snapshot(store, args.word(0), threads))
         {
-            visit[i] = 0;
+            return 1;
         }
-        x = where(v);
-        kyu.enqueue(v);
-        visit[x] = 1;
-        do
+        snapshot_store::reader snap = store.pin();
+        cores found = threads > 1 ? core_numbers(*snap, threads) : core_numbers(*snap);
+        buffered_sink out(1);
+        for (int i = 0; i < snap->size(); i++)
         {
-            v = kyu.dequeue();
-            x = where(v);
-            cout << "\n"
-                 << head[x]->name;
-            gnode *temp = head[x]->next;
-            while (temp != NULL)
+            out << snap->name(found.order[i]) << ' ' << found.core[found.order[i]] << '\n';
+        }
+        out << "degeneracy " << found.degeneracy << '\n';
+        return out.flush() ? 0 : 1;
+    }
+    // graph --sssp <edge file> <name> [threads] [width] [--undirected]
+    // prints "name distance" for everyone reachable from <name>, distances
+    // summing the file's strengths.
+    if (argc >= 2 && strcmp(argv[1], "--sssp") == 0 && args.count() >= 2)
+    {
+        int threads = args.threads(2);
+        snapshot_store store(args.has("--undirected"));
+        if (!args.only({"--undirected"}) || !load_snapshot(store, args.word(0), threads))
+        {
+            return 1;
+        }
+        snapshot_store::reader snap = store.pin();
+        int s = snap->id(args.word(1));
+        if (s < 0)
+        {
+            cout << "No such person: " << args.word(1) << "\n";
+            return 1;
+        }
+        vector<double> dist = shortest_distances(*snap, s, threads, args.real(3, 0));
+        buffered_sink out(1);
+        for (int v = 0; v < snap->size(); v++)
+        {
+            if (dist[v] != numeric_limits<double>::infinity())
             {
-                if (visit[temp->id] == 0)
-                {
-                    kyu.enqueue(temp->name);
-                    visit[temp->id] = 1;
-                }
-                temp = temp->next;
+                out << snap->name(v) << ' ' << (float)dist[v] << '\n';
             }
-            if (kyu.rear == kyu.front)
+        }
+        return out.flush() ? 0 : 1;
+    }
+    // graph --recommend-all <edge file> <k> [threads] [--adamic-adar]
+    // [--undirected] prints "name suggestion score" lines, up to <k>
+    // suggestions per person, everyone in one batch.
+    if (argc >= 2 && strcmp(argv[1], "--recommend-all") == 0 && args.count() >= 2)
+    {
+        int threads = args.threads(2);
+        snapshot_store store(args.has("--undirected"));
+        if (!args.only({"--undirected", "--adamic-adar"}) || !load_snapshot(store, args.word(0), threads))
+        {
+            return 1;
+        }
+        snapshot_store::reader snap = store.pin();
+        vector<vector<pair<double, int>>> best = recommend_all(*snap, (int)args.number(1, 0), args.has("--adamic-adar"), max(threads, 1));
+        buffered_sink out(1);
+        for (int v = 0; v < snap->size(); v++)
+        {
+            for (size_t i = 0; i < best[v].size(); i++)
             {
-                break;
+                out << snap->name(v) << ' ' << snap->name(best[v][i].second) << ' ' << (float)best[v][i].first << '\n';
             }
-        } while (1);
+        }
+        return out.flush() ? 0 : 1;
     }
-}
-
-int main()
-{
-    graph gp;
+    // graph --circles <edge file> [threads] prints "name circle size" for
+    // everyone, circles numbered in topological order.
+    if (argc >= 2 && strcmp(argv[1], "--circles") == 0 && args.count() >= 1)
+    {
+        int threads = args.threads(1);
+        snapshot_store store;
+        if (!args.only({}) || !load_snapshot(store, args.word(0), threads))
+        {
+            return 1;
+        }
+        snapshot_store::reader snap = store.pin();
+        strong_components found = threads > 1 ? strongly_connected(*snap, threads) : strongly_connected(*snap);
+        for (int v = 0; v < snap->size(); v++)
+        {
+            cout << snap->name(v) << " " << found.of[v] << " " << found.size[found.of[v]] << "\n";
+        }
+        return 0;
+    }
+    // graph --estimate <people> <friendships> [average name length]
+    if (argc >= 2 && strcmp(argv[1], "--estimate") == 0 && args.count() >= 2)
+    {
+        long people = args.number(0, 0), friendships = args.number(1, 0);
+        double length = args.real(2, 8);
+        estimate_memory(people, friendships, length, false, false).print("Snapshot:");
+        estimate_memory(people, friendships, length, true, false).print("Snapshot with strengths:");
+        estimate_memory(people, friendships, length, false, true).print("Compressed snapshot:");
+        return 0;
+    }
+    // graph [--undirected] [--weighted] [--cache=<bytes>] [--log=<file>]
+    // [--compact=background|inline] [--compact-at=<fraction>]: --undirected
+    // makes every friendship mutual and --weighted asks for its strength
+    // (friendships are one-way and unweighted otherwise); --cache bounds the
+    // traversal cache (1 MiB by default); --log makes every change durable
+    // in <file> and, if it already holds a graph, recovers that, flags and
+    // all, instead of asking; --compact picks where removed friendships are
+    // swept up (a background thread by default) and --compact-at what dead
+    // fraction triggers it (0.25).
+    mode_args options(argc, argv, 1);
+    if (!options.only({"--undirected", "--weighted", "--cache=", "--log=", "--compact=", "--compact-at="}))
+    {
+        return 1;
+    }
+    bool mutual = options.has("--undirected"), strengths = options.has("--weighted");
+    size_t cache = (size_t)atol(options.value("--cache=", "0"));
+    string log = options.value("--log=", "");
+    bool in_background = strcmp(options.value("--compact=", "background"), "inline") != 0;
+    double compact_at = atof(options.value("--compact-at=", "0.25"));
+    bool recovering = write_ahead_log::saved(log);
+    if (recovering && !write_ahead_log::flags(log, mutual, strengths))
+    {
+        cout << "Can't recover from " << log << "\n";
+        return 1;
+    }
+    graph gp(mutual, strengths, log);
+    if (recovering && !gp.logging())
+    {
+        return 1;
+    }
+    if (cache > 0)
+    {
+        gp.cache_budget(cache);
+    }
+    gp.compaction(compact_at, in_background);
     string stri;
     int choice;
-    gp.create();
+    if (!recovering)
+    {
+        gp.create();
+    }
     do
     {
         cout << "\n\n*******************\n";
-        cout << "What would you like to do? \n1. DFS Recursive \n2. DFS Non-Recursive \n3. BFS \n4. Display all friends \n5. Exit\nEnter choice: ";
+        cout << "What would you like to do? \n1. DFS Recursive \n2. DFS Non-Recursive \n3. BFS \n4. Display all friends \n5. Exit\n6. Shortest path \n7. Friend groups \n8. Count triangles \n9. Remove a friendship \n10. Remove a person \n11. Weighted shortest path \n12. Memory usage \n13. Traversal stats \n14. Who can a person reach \n15. People you may know \n16. Bridge people \n17. Communities \n18. Hops via distance index \n19. Traversal cache stats \n20. Follow circles \n21. Reach estimates \n22. Export \n23. Random walks \n24. Friends over time \n25. Similar people \n26. Core groups \n27. Explore a circle \nEnter choice: ";
         cin >> choice;
         switch (choice)
         {
@@ -329,6 +7872,102 @@ int main()
         case 5:
             break;
 
+        case 6:
+            cout << "\n\nShortest path between two friends... \n";
+            gp.path();
+            break;
+
+        case 7:
+            cout << "\n\nConnected friend groups... \n";
+            gp.groups();
+            break;
+
+        case 8:
+            gp.triangles();
+            break;
+
+        case 9:
+            gp.unfriend();
+            break;
+
+        case 10:
+            gp.remove();
+            break;
+
+        case 11:
+            cout << "\n\nLightest path between two friends... \n";
+            gp.weighted_path();
+            break;
+
+        case 12:
+            cout << "\n\nMemory usage... \n";
+            gp.usage();
+            break;
+
+        case 13:
+            report_stats("graph_trace.json");
+            break;
+
+        case 14:
+            cout << "\n\nParallel reachability... \n";
+            gp.reach();
+            break;
+
+        case 15:
+            cout << "\n\nPeople you may know... \n";
+            gp.suggest();
+            break;
+
+        case 16:
+            cout << "\n\nBetweenness centrality... \n";
+            gp.bridges();
+            break;
+
+        case 17:
+            cout << "\n\nLabel propagation communities... \n";
+            gp.communities_of();
+            break;
+
+        case 18:
+            gp.hop_distance();
+            break;
+
+        case 19:
+            gp.cache_stats();
+            break;
+
+        case 20:
+            gp.circles();
+            break;
+
+        case 21:
+            gp.reach_estimates();
+            break;
+
+        case 22:
+            gp.export_graph();
+            break;
+
+        case 23:
+            gp.random_walks();
+            break;
+
+        case 24:
+            gp.over_time();
+            break;
+
+        case 25:
+            gp.similar_people();
+            break;
+
+        case 26:
+            gp.core_groups();
+            break;
+
+        case 27:
+            gp.explore_circle();
+            break;
+
         default:
             cout << "\nPlease choode from the menu!\n";
             break;